@@ -6,6 +6,8 @@ import struct
 import json
 import sys
 
+from gen_dict import write_locale_bin
+
 
 
 def main():
@@ -19,16 +21,24 @@ def main():
 
     dict_filename = sys.argv[1]
 
-    json_dict = json.load(open(dict_filename, 'rb'))
-    hash_dict = {int(key) : value for (key, value) in json_dict.iteritems() if key.isdigit()}
-    #create binary resource loadable as a pebble dictionary
-    with open(dict_filename.replace('.json','.bin'), 'w') as output_bin:
-      output_bin.write(struct.pack('I', len(hash_dict))) #count of entries
-      for (key, value) in hash_dict.iteritems():
-        output_bin.write(struct.pack('I',key)) #key
-        output_bin.write(struct.pack('I',len(value.encode('utf-8')) + 1)) #length of string including null
-        output_bin.write(value.encode('utf-8')) #write string as c string
-        output_bin.write(struct.pack('B',0)) #null terminate string
+    json_dict = json.load(open(dict_filename, 'r'))
+    hash_dict = {int(key) : value for (key, value) in json_dict.items() if key.isdigit()}
+
+    # The strings are looked up by their index in the English table (see
+    # src/locale_ids.h), so every locale has to have the same keys
+    english_filename = os.path.join(os.path.dirname(dict_filename), 'locale_english.json')
+    english_json = json.load(open(english_filename, 'r'))
+    english_dict = {int(key) : value for (key, value) in english_json.items() if key.isdigit()}
+    for key in english_dict:
+        if key not in hash_dict:
+            print("%s: missing \"%s\", using English" % (dict_filename, english_dict[key]))
+            hash_dict[key] = english_dict[key]
+    for key in list(hash_dict):
+        if key not in english_dict:
+            print("%s: dropping unknown %d \"%s\"" % (dict_filename, key, hash_dict[key]))
+            del hash_dict[key]
+
+    write_locale_bin(hash_dict, dict_filename.replace('.json', '.bin'))
 
 
 if __name__ == '__main__':
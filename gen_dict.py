@@ -6,6 +6,9 @@ import struct
 import json
 
 
+# Longest string in bytes - LOCALE_SLOT_BYTES in src/localize.h less the null
+MAX_STRING_BYTES = 31
+
 #Helper functions
 def hash_djb2(string):
     """hash a string using djb2 with seed 5381
@@ -20,6 +23,58 @@ def hash_djb2(string):
     return hashval.value & 0x7FFFFFFF
 
 
+def write_locale_bin(hash_dict, output_filename):
+    """write the binary locale resource read by src/localize.c
+    Layout, all little endian:
+        uint32 count
+        count x (uint32 hash, uint32 offset) sorted by hash
+        strings, null terminated, offsets are from the first one
+    Args:
+        hash_dict (dict): hash to string
+        output_filename (str): .bin to write
+    """
+    table = bytearray()
+    blob = bytearray()
+    for key in sorted(hash_dict.keys()):
+        table += struct.pack('<II', key, len(blob))
+        value = hash_dict[key]
+        if not isinstance(value, bytes):
+            value = value.encode('utf-8')
+        if len(value) > MAX_STRING_BYTES:
+            print("\"%s\" is longer than %d bytes" % (value.decode('utf-8'), MAX_STRING_BYTES))
+            sys.exit(1)
+        blob += value + b'\0'
+    with open(output_filename, 'wb') as output_bin:
+        output_bin.write(struct.pack('<I', len(hash_dict)))
+        output_bin.write(table)
+        output_bin.write(blob)
+
+
+def write_locale_ids(hash_dict, header_filename):
+    """write the header that maps the string hashes to their index in the
+    locale resources, so _() becomes an array index at runtime
+    Args:
+        hash_dict (dict): hash to string
+        header_filename (str): .h to write
+    """
+    with open(header_filename, 'w') as header:
+        header.write("// Generated by gen_dict.py - do not edit\n")
+        header.write("#pragma once\n\n")
+        header.write("#include <stdint.h>\n\n")
+        header.write("#define LOCALE_STRING_COUNT %d\n" % len(hash_dict))
+        header.write("#define LOCALE_ID_NONE -1\n\n")
+        header.write("// Index in the hash sorted table of the locale resources. A hash\n")
+        header.write("// collision would be a duplicate case - the build fails on it.\n")
+        header.write("static inline __attribute__((always_inline)) int locale_id(uint32_t hashval) {\n")
+        header.write("  switch (hashval) {\n")
+        for (index, key) in enumerate(sorted(hash_dict.keys())):
+            comment = hash_dict[key].replace('*/', '* /')
+            header.write("    case %du: return %d; /* %s */\n" % (key, index, comment))
+        header.write("    default: return LOCALE_ID_NONE;\n")
+        header.write("  }\n")
+        header.write("}\n")
+
+
 def gen_loc_dict(code_dir):
     fileglob_list = []
     loc_dict = {}
@@ -30,12 +85,18 @@ def gen_loc_dict(code_dir):
                 if ".c" in filename[-2:]]:
             fileglob_list.append(os.path.join(root, filename))
     for filename in fileglob_list:
-        with open(filename, 'rb') as afile:
+        with open(filename, 'r') as afile:
             text = afile.read()
             match_list = re.finditer(pbllog_regex, text)
             if match_list:
                 for match in match_list:
-                  loc_dict[hash_djb2(match.group('loc'))] = match.group('loc')
+                  loc = match.group('loc')
+                  hashval = hash_djb2(loc)
+                  if hashval in loc_dict and loc_dict[hashval] != loc:
+                      print("Hash collision of \"%s\" and \"%s\" in %s" % (
+                          loc, loc_dict[hashval], filename))
+                      sys.exit(1)
+                  loc_dict[hashval] = loc
 
     return loc_dict
 
@@ -52,30 +113,11 @@ def main():
     output_filename = sys.argv[2]
 
     hash_dict = gen_loc_dict(code_dir) 
-    json_dict = {str(key) : value for (key, value) in hash_dict.iteritems()}
-    json.dump(json_dict, open(output_filename, "wb"), indent=2, sort_keys=True)
+    json_dict = {str(key) : value for (key, value) in hash_dict.items()}
+    json.dump(json_dict, open(output_filename, "w"), indent=2, sort_keys=True)
     print("%s now has %d entries\n" % (output_filename, len(hash_dict)))
-    #create binary resource loadable as a pebble dictionary
-    with open(output_filename.replace('.json', '.bin'), 'wb') as output_bin:
-      output_bin.write(struct.pack('I', len(hash_dict))) #count of entries
-      for (key, value) in hash_dict.iteritems():
-        output_bin.write(struct.pack('I',key)) #key
-        output_bin.write(struct.pack('I',len(value) + 1)) #length of string including null
-        output_bin.write(value) #write string as c string
-        output_bin.write(struct.pack('B',0)) #null terminate string
-
-
-    #output tuple array
-    #with open(output_filename + '.bin', 'wb') as output_bin:
-      #dump the tuple header for the dictionary
-    #  output_bin.write(struct.pack('B', len(hash_dict))) #count of items
-    #  for (key, value) in hash_dict.iteritems():
-    #    output_bin.write(struct.pack('I',key)) #key
-    #    output_bin.write(struct.pack('b',1)) #type cstring
-    #    output_bin.write(struct.pack('<H',len(value) + 1)) #length of string including null
-    #    output_bin.write(value) #write string as c string
-    #    output_bin.write(struct.pack('B',0)) #null terminate string
-
+    write_locale_bin(hash_dict, output_filename.replace('.json', '.bin'))
+    write_locale_ids(hash_dict, os.path.join(code_dir, 'locale_ids.h'))
 
 
 if __name__ == '__main__':
@@ -0,0 +1,89 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+#include "accel_trace.h"
+#include "constants.h"
+
+// The worker peeks every 300 ms
+#define DEFAULT_SAMPLE_MS 300
+
+void accel_trace_default(AccelTraceHeader *header, uint32_t start_time) {
+    memset(header, 0, sizeof(AccelTraceHeader));
+    header->magic = ACCEL_TRACE_MAGIC;
+    header->version = ACCEL_TRACE_VERSION;
+    header->sample_ms = DEFAULT_SAMPLE_MS;
+    header->start_time = start_time;
+    header->mode = MODE_WORKDAY;
+    header->start_wake_hour = 6;
+    header->start_wake_min = 30;
+    header->end_wake_hour = 7;
+    header->end_wake_min = 0;
+    header->up_coef = UP_COEF_NORMAL;
+    header->down_coef = DOWN_COEF_NORMAL;
+}
+
+bool accel_trace_load(const char *path, AccelTrace *trace) {
+    memset(trace, 0, sizeof(AccelTrace));
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    bool ok = fread(&trace->header, sizeof(AccelTraceHeader), 1, in) == 1;
+    if (!ok || trace->header.magic != ACCEL_TRACE_MAGIC || trace->header.version != ACCEL_TRACE_VERSION
+            || trace->header.sample_ms == 0) {
+        fprintf(stderr, "%s: not an accelerometer trace\n", path);
+        fclose(in);
+        return false;
+    }
+    uint32_t samples = trace->header.samples;
+    trace->samples = malloc(sizeof(AccelTraceSample) * (samples ? samples : 1));
+    if (trace->samples == NULL || fread(trace->samples, sizeof(AccelTraceSample), samples, in) != samples) {
+        fprintf(stderr, "%s: truncated, %u samples expected\n", path, samples);
+        accel_trace_free(trace);
+        fclose(in);
+        return false;
+    }
+    fclose(in);
+    return true;
+}
+
+void accel_trace_free(AccelTrace *trace) {
+    free(trace->samples);
+    trace->samples = NULL;
+}
+
+bool accel_trace_write_header(FILE *out, const AccelTraceHeader *header) {
+    return fwrite(header, sizeof(AccelTraceHeader), 1, out) == 1;
+}
+
+bool accel_trace_write_sample(FILE *out, const AccelTraceSample *sample) {
+    return fwrite(sample, sizeof(AccelTraceSample), 1, out) == 1;
+}
+
+bool accel_trace_finish(FILE *out, uint32_t samples) {
+    if (fseek(out, offsetof(AccelTraceHeader, samples), SEEK_SET) != 0)
+        return false;
+    return fwrite(&samples, sizeof(samples), 1, out) == 1 && fseek(out, 0, SEEK_END) == 0;
+}
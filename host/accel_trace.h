@@ -0,0 +1,90 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Recorded or generated accelerometer stream of a night, as the worker
+// would peek it. Little endian, a header and then one record per
+// sample_ms:
+//
+//   AccelTraceHeader
+//   AccelTraceSample[samples]
+//
+// The header carries the settings of the night too, so a trace replays
+// the same way wherever it goes.
+
+#ifndef PebSlee_host_accel_trace_h
+#define PebSlee_host_accel_trace_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ACCEL_TRACE_MAGIC 0x54415350    // "PSAT"
+#define ACCEL_TRACE_VERSION 1
+
+typedef struct __attribute__((__packed__)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sample_ms;         // between records
+    uint32_t start_time;        // UTC of the first record
+    uint32_t samples;
+    int32_t utc_offset;         // seconds, local time is UTC plus this
+    uint32_t dst_time;          // UTC when the offset changes, 0 - never
+    int32_t dst_offset;         // offset from then on
+    // GlobalConfig of the night
+    uint8_t mode;
+    uint8_t start_wake_hour;
+    uint8_t start_wake_min;
+    uint8_t end_wake_hour;
+    uint8_t end_wake_min;
+    uint8_t up_coef;
+    uint8_t down_coef;
+    uint8_t reserved;
+} AccelTraceHeader;
+
+typedef struct __attribute__((__packed__)) {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    int8_t status;              // 0, or what accel_service_peek fails with
+    uint8_t did_vibrate;
+} AccelTraceSample;
+
+typedef struct {
+    AccelTraceHeader header;
+    AccelTraceSample *samples;
+} AccelTrace;
+
+// Defaults of a night starting at start_time, no samples yet
+void accel_trace_default(AccelTraceHeader *header, uint32_t start_time);
+
+// Reads the whole trace, false with a message on stderr when it is broken
+bool accel_trace_load(const char *path, AccelTrace *trace);
+void accel_trace_free(AccelTrace *trace);
+
+// Writing is streamed, the sample count is fixed up at the end
+bool accel_trace_write_header(FILE *out, const AccelTraceHeader *header);
+bool accel_trace_write_sample(FILE *out, const AccelTraceSample *sample);
+bool accel_trace_finish(FILE *out, uint32_t samples);
+
+#endif
@@ -0,0 +1,164 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <pebble.h>
+#include "sim.h"
+#include "energy.h"
+
+#define UAS_PER_UAH 3600.0
+
+typedef struct {
+    const char *name;
+    size_t offset;
+} CostName;
+
+static const CostName cost_names[] = {
+    { "wakeup", offsetof(EnergyCosts, wakeup) },
+    { "accel_sample", offsetof(EnergyCosts, accel_sample) },
+    { "accel_on_ms", offsetof(EnergyCosts, accel_on_ms) },
+    { "flash_lookup", offsetof(EnergyCosts, flash_lookup) },
+    { "flash_read", offsetof(EnergyCosts, flash_read) },
+    { "flash_read_byte", offsetof(EnergyCosts, flash_read_byte) },
+    { "flash_write", offsetof(EnergyCosts, flash_write) },
+    { "flash_write_byte", offsetof(EnergyCosts, flash_write_byte) },
+    { "vibe_ms", offsetof(EnergyCosts, vibe_ms) },
+    { "light_ms", offsetof(EnergyCosts, light_ms) },
+    { "message", offsetof(EnergyCosts, message) },
+    { "message_byte", offsetof(EnergyCosts, message_byte) },
+    { "worker_message", offsetof(EnergyCosts, worker_message) },
+};
+
+void energy_default_costs(EnergyCosts *costs) {
+    costs->wakeup = 30;             // ~6 mA for 5 ms
+    costs->accel_sample = 1;
+    costs->accel_on_ms = 0.02;      // ~20 uA while sampling
+    costs->flash_lookup = 5;
+    costs->flash_read = 10;
+    costs->flash_read_byte = 0.01;
+    costs->flash_write = 200;       // program and the share of an erase
+    costs->flash_write_byte = 0.5;
+    costs->vibe_ms = 80;            // ~80 mA motor
+    costs->light_ms = 10;
+    costs->message = 1500;          // radio wakeup and the connection event
+    costs->message_byte = 2;
+    costs->worker_message = 10;
+}
+
+bool energy_load_costs(const char *path, EnergyCosts *costs) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    char line[128];
+    int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), in)) {
+        number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char name[32];
+        double value;
+        int fields = sscanf(line, "%31s %lf", name, &value);
+        if (fields <= 0)
+            continue;
+        ok = false;
+        for (unsigned i = 0; fields == 2 && i < sizeof(cost_names) / sizeof(cost_names[0]); i++) {
+            if (strcmp(name, cost_names[i].name) == 0) {
+                *(double *)((char *)costs + cost_names[i].offset) = value;
+                ok = true;
+            }
+        }
+        if (!ok)
+            fprintf(stderr, "%s:%d: unknown cost\n", path, number);
+    }
+    fclose(in);
+    return ok;
+}
+
+void energy_collect(EnergyCounts *counts, const EnergyCounts *start) {
+    const SimDeviceCounters *device = sim_device_counters();
+    const SimPersistCounters *persist = sim_persist_counters();
+    const SimLinkCounters *link = sim_link_counters();
+
+    counts->wakeups = sim_wakeups();
+    counts->accel_samples = device->accel_samples;
+    counts->accel_on_ms = device->accel_on_ms;
+    counts->flash_lookups = persist->lookups;
+    counts->flash_reads = persist->reads;
+    counts->flash_read_bytes = persist->read_bytes;
+    counts->flash_writes = persist->writes;
+    counts->flash_write_bytes = persist->write_bytes;
+    counts->vibe_ms = device->vibe_ms;
+    counts->light_ms = device->light_ms;
+    // Lost ones went on air too
+    counts->messages = link->sends + link->phone_msgs;
+    counts->message_bytes = link->watch_bytes + link->phone_bytes;
+    counts->worker_messages = device->worker_msgs;
+
+    if (start) {
+        uint32_t *count = (uint32_t *)counts;
+        const uint32_t *from = (const uint32_t *)start;
+        for (unsigned i = 0; i < sizeof(EnergyCounts) / sizeof(uint32_t); i++)
+            count[i] -= from[i];
+    }
+}
+
+static double cpu_uas(const EnergyCounts *c, const EnergyCosts *k) {
+    return c->wakeups * k->wakeup;
+}
+
+static double accel_uas(const EnergyCounts *c, const EnergyCosts *k) {
+    return c->accel_samples * k->accel_sample + c->accel_on_ms * k->accel_on_ms;
+}
+
+static double flash_uas(const EnergyCounts *c, const EnergyCosts *k) {
+    return c->flash_lookups * k->flash_lookup
+        + c->flash_reads * k->flash_read + c->flash_read_bytes * k->flash_read_byte
+        + c->flash_writes * k->flash_write + c->flash_write_bytes * k->flash_write_byte;
+}
+
+static double radio_uas(const EnergyCounts *c, const EnergyCosts *k) {
+    return c->messages * k->message + c->message_bytes * k->message_byte;
+}
+
+double energy_uah(const EnergyCounts *c, const EnergyCosts *k) {
+    return (cpu_uas(c, k) + accel_uas(c, k) + flash_uas(c, k)
+        + c->vibe_ms * k->vibe_ms + c->light_ms * k->light_ms
+        + radio_uas(c, k) + c->worker_messages * k->worker_message) / UAS_PER_UAH;
+}
+
+void energy_print(FILE *out, const EnergyCounts *c, const EnergyCosts *k) {
+    fprintf(out, "counts wakeups %u accel %u accel_on_ms %u flash_lookups %u reads %u/%uB writes %u/%uB"
+            " vibe_ms %u light_ms %u msgs %u/%uB worker_msgs %u\n",
+            c->wakeups, c->accel_samples, c->accel_on_ms, c->flash_lookups,
+            c->flash_reads, c->flash_read_bytes, c->flash_writes, c->flash_write_bytes,
+            c->vibe_ms, c->light_ms, c->messages, c->message_bytes, c->worker_messages);
+    fprintf(out, "uAh cpu %.1f accel %.1f flash %.1f vibe %.1f light %.1f radio %.1f worker_msgs %.1f total %.1f\n",
+            cpu_uas(c, k) / UAS_PER_UAH, accel_uas(c, k) / UAS_PER_UAH, flash_uas(c, k) / UAS_PER_UAH,
+            c->vibe_ms * k->vibe_ms / UAS_PER_UAH, c->light_ms * k->light_ms / UAS_PER_UAH,
+            radio_uas(c, k) / UAS_PER_UAH, c->worker_messages * k->worker_message / UAS_PER_UAH,
+            energy_uah(c, k));
+}
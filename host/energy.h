@@ -0,0 +1,87 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Energy cost model of the host simulation. The shim counts what draws
+// power - CPU wakeups, accelerometer, flash, vibration, backlight and the
+// radio - and a cost table turns the counts into charge.
+//
+// Costs are in microamp seconds per unit. The defaults are estimates for
+// comparing builds and strategies, not a measurement of a watch; a cost
+// file overrides them with "name value" lines, # starts a comment:
+//
+//   wakeup accel_sample accel_on_ms flash_lookup flash_read flash_read_byte
+//   flash_write flash_write_byte vibe_ms light_ms message message_byte
+//   worker_message
+
+#ifndef PebSlee_host_energy_h
+#define PebSlee_host_energy_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+    double wakeup;
+    double accel_sample;
+    double accel_on_ms;
+    double flash_lookup;
+    double flash_read;
+    double flash_read_byte;
+    double flash_write;
+    double flash_write_byte;
+    double vibe_ms;
+    double light_ms;
+    double message;             // sent or received over Bluetooth
+    double message_byte;
+    double worker_message;
+} EnergyCosts;
+
+typedef struct {
+    uint32_t wakeups;
+    uint32_t accel_samples;
+    uint32_t accel_on_ms;
+    uint32_t flash_lookups;
+    uint32_t flash_reads;
+    uint32_t flash_read_bytes;
+    uint32_t flash_writes;
+    uint32_t flash_write_bytes;
+    uint32_t vibe_ms;
+    uint32_t light_ms;
+    uint32_t messages;
+    uint32_t message_bytes;
+    uint32_t worker_messages;
+} EnergyCounts;
+
+void energy_default_costs(EnergyCosts *costs);
+// Overrides the costs named in the file, false with a message on stderr
+bool energy_load_costs(const char *path, EnergyCosts *costs);
+
+// Counts of the shim since sim_reset(), or since start when given
+void energy_collect(EnergyCounts *counts, const EnergyCounts *start);
+
+double energy_uah(const EnergyCounts *counts, const EnergyCosts *costs);
+// Two lines: the counts, then microamp hours by source
+void energy_print(FILE *out, const EnergyCounts *counts, const EnergyCosts *costs);
+
+#endif
@@ -0,0 +1,272 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Live stream check: feeds minute values to src/comm.c the way the worker
+// hands them over and checks that the phone gets every value under its
+// own minute - with missing minutes, a new night, a phone that is away
+// and acks that take longer than the minutes come in. The last case
+// checks that the live view in logic.c keeps the missing minutes empty.
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pebble.h>
+#include "sim.h"
+#include "comm.h"
+#include "logic.h"
+
+#define SIM_EPOCH 1420092000
+#define MAX_NIGHTS 2
+#define MAX_MINUTES 240
+// Values after the last full batch wait for the next one
+#define PENDING_MAX 10
+#define FEED_START_MS 1000
+#define MINUTE_MS 60000
+
+typedef struct {
+    const char *name;
+    uint32_t latency_ms;
+    uint32_t step_ms;           // between two minute values
+    int minutes;                // per night
+    int nights;
+    int skip_from;              // minutes skip_from..skip_to are not handed over
+    int skip_to;
+    int away_from;              // phone not connected from this value...
+    int away_to;                // ...to this one
+    int slow_until;             // values before this one come every 100 ms
+} Scenario;
+
+static const Scenario scenarios[] = {
+    { "steady", 30, MINUTE_MS, 60, 1, -1, -1, -1, -1, 0 },
+    { "gap", 30, MINUTE_MS, 60, 1, 13, 13, -1, -1, 0 },
+    { "gaps", 30, MINUTE_MS, 60, 1, 27, 31, -1, -1, 0 },
+    { "restart", 30, MINUTE_MS, 25, 2, -1, -1, -1, -1, 0 },
+    { "away", 30, MINUTE_MS, 200, 1, -1, -1, 20, 140, 0 },
+    { "slowack", 2000, MINUTE_MS, 200, 1, 150, 150, -1, -1, 120 },
+};
+
+// ================== Phone stand-in ======================
+static struct {
+    int night;
+    int max_minute;
+    int batches;
+    int mismatches;
+    int received[MAX_NIGHTS][MAX_MINUTES];    // value + 1, 0 - not received
+} phone;
+
+static struct {
+    int fed[MAX_NIGHTS][MAX_MINUTES];          // value + 1, 0 - not fed
+    int order[MAX_NIGHTS][MAX_MINUTES];        // index of the value in the feed
+    int count;
+    int night;
+    int minute;
+} watch;
+
+static uint8_t minute_value(int night, int minute) {
+    return (minute * 37 + night * 101 + 11) & 0xFF;
+}
+
+static void phone_receive(DictionaryIterator *iter) {
+    Tuple *first = dict_find(iter, PS_APP_MSG_LIVE_FIRST_MINUTE);
+    Tuple *values = dict_find(iter, PS_APP_MSG_LIVE_VALUES);
+    if (!first || !values)
+        return;
+    const uint8_t *data = values->value->data;
+    int minute = first->value->uint16;
+    // Batches of a night do not overlap - going back is the next night
+    if (phone.batches > 0 && minute <= phone.max_minute)
+        phone.night++;
+    phone.batches++;
+    for (int i = 0; i < values->length; i++, minute++) {
+        if (phone.night >= MAX_NIGHTS || minute >= MAX_MINUTES) {
+            phone.mismatches++;
+            continue;
+        }
+        phone.received[phone.night][minute] = data[i] + 1;
+        phone.max_minute = minute;
+    }
+}
+
+static void phone_enable_live(void *data) {
+    Tuplet tuplets[] = {
+        TupletInteger(PS_APP_TO_WATCH_COMMAND, (uint8_t)PS_APP_MESSAGE_COMMAND_LIVE_STREAM),
+        TupletInteger(PS_APP_TO_WATCH_LIVE_ENABLE, (uint8_t)YES),
+    };
+    sim_phone_send(tuplets, 2);
+}
+
+// ================== Watch side ======================
+static const Scenario *scenario;
+
+static void set_connected(bool connected) {
+    SimLink link;
+    sim_link_default(&link);
+    link.latency_ms = scenario->latency_ms;
+    link.connected = connected;
+    sim_link_set(&link);
+}
+
+static void feed_minute(void *data) {
+    if (watch.minute >= scenario->minutes) {
+        if (++watch.night >= scenario->nights)
+            return;
+        watch.minute = 0;
+    }
+    int night = watch.night;
+    int minute = watch.minute++;
+
+    if (watch.count == scenario->away_from)
+        set_connected(false);
+    if (watch.count == scenario->away_to)
+        set_connected(true);
+
+    if (minute < scenario->skip_from || minute > scenario->skip_to) {
+        uint8_t value = minute_value(night, minute);
+        watch.fed[night][minute] = value + 1;
+        watch.order[night][minute] = watch.count;
+        live_minute_value(minute, value);
+    }
+    watch.count++;
+    sim_schedule(watch.count < scenario->slow_until ? 100 : scenario->step_ms, feed_minute, NULL);
+}
+
+static void app_init() {
+    // As handle_init() in main.c
+    int inbox_size = app_message_inbox_size_maximum();
+    int outbox_size = app_message_outbox_size_maximum();
+    app_message_open(inbox_size, outbox_size);
+    set_outbox_size(outbox_size);
+
+    app_message_register_inbox_received(in_received_handler);
+    app_message_register_inbox_dropped(in_dropped_handler);
+    app_message_register_outbox_sent(out_sent_handler);
+    app_message_register_outbox_failed(out_failed_handler);
+}
+
+// ================== Scenarios ======================
+static void run_scenario(const Scenario *s) {
+    sim_reset(SIM_EPOCH);
+    scenario = s;
+    set_connected(true);
+    app_init();
+
+    memset(&phone, 0, sizeof(phone));
+    memset(&watch, 0, sizeof(watch));
+    sim_phone_set_receiver(phone_receive);
+    sim_schedule(0, phone_enable_live, NULL);
+    sim_schedule(FEED_START_MS, feed_minute, NULL);
+    while (sim_step()) {
+    }
+
+    // Every value the phone got is the one of its minute. Fed values may
+    // be missing only while the phone was away or the acks were slow,
+    // and at the end, where they wait for the next batch.
+    int must_from = MAX(s->away_to, s->slow_until);
+    int received = 0;
+    int lost = 0;
+    for (int n = 0; n < MAX_NIGHTS; n++) {
+        for (int m = 0; m < MAX_MINUTES; m++) {
+            if (phone.received[n][m]) {
+                received++;
+                if (phone.received[n][m] != watch.fed[n][m])
+                    phone.mismatches++;
+            } else if (watch.fed[n][m] && watch.order[n][m] >= must_from
+                       && watch.order[n][m] < watch.count - PENDING_MAX) {
+                lost++;
+            }
+        }
+    }
+    const SimLinkCounters *c = sim_link_counters();
+    bool ok = phone.mismatches == 0 && lost == 0 && received > 0;
+    printf("%-8s %6d %6d %7lu %6d %5d %8d  %s\n",
+           s->name, watch.count, received, (unsigned long)c->watch_msgs, phone.night + 1,
+           lost, phone.mismatches, ok ? "ok" : "FAILED");
+    fflush(stdout);
+    exit(ok ? 0 : 1);
+}
+
+/*
+ * Minutes 0-9, 13-15, then a new night - the view has holes for 10-12
+ */
+static void run_view_check() {
+    int fed = 0;
+    int mismatches = 0;
+    int holes = 0;
+    for (int minute = 0; minute < 16; minute++) {
+        if (minute >= 10 && minute <= 12)
+            continue;
+        update_live_data(minute, minute_value(0, minute), 1);
+        fed++;
+    }
+    LiveData *live = read_live_data();
+    for (int i = 0; i < live->recent_count; i++) {
+        if (i >= 10 && i <= 12) {
+            holes += live->recent[i] == LIVE_GAP;
+        } else if (live->recent[i] != (MIN(minute_value(0, i), LIVE_GAP - 1))) {
+            mismatches++;
+        }
+    }
+    int shown = live->recent_count;
+    bool ok = shown == 16 && holes == 3 && mismatches == 0;
+
+    update_live_data(0, minute_value(1, 0), 1);
+    fed++;
+    ok = ok && live->recent_count == 1 && live->minutes == 0;
+
+    printf("%-8s %6d %6d %7d %6d %5d %8d  %s\n",
+           "view", fed, shown, 0, 2, 3 - holes, mismatches, ok ? "ok" : "FAILED");
+    fflush(stdout);
+    exit(ok ? 0 : 1);
+}
+
+static bool run_forked(const Scenario *s) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (s)
+            run_scenario(s);
+        else
+            run_view_check();
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *only = argc > 1 ? argv[1] : NULL;
+    int failed = 0;
+
+    printf("%-8s %6s %6s %7s %6s %5s %8s\n",
+           "case", "fed", "rcvd", "w->p", "nights", "lost", "mismatch");
+    for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        if (only && strcmp(only, scenarios[i].name) != 0)
+            continue;
+        if (!run_forked(&scenarios[i]))
+            failed++;
+    }
+    if (!only || strcmp(only, "view") == 0) {
+        if (!run_forked(NULL))
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
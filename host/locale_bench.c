@@ -0,0 +1,161 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Locale benchmark: loads every locale resource with src/localize.c and
+// reports what locale_init reads and keeps, then runs a session of
+// lookups like the app does - the main window, the menu scrolled down
+// and up, the main window again. "ram" is the heap plus the static
+// string cache of the lazy mode. "dict copy" is what the former loader
+// allocated for the same resource: a Dictionary with a 7 byte tuple
+// header per string plus a copy of every string.
+//
+// Built twice, the default lazy mode and with LOCALE_EAGER.
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pebble.h>
+#include "sim.h"
+#include "localize.h"
+
+#define LOOKUP_ROUNDS 10000
+
+#ifdef LOCALE_EAGER
+#define MODE_NAME "eager"
+#define STATIC_BYTES 0
+#else
+#define MODE_NAME "lazy"
+#define STATIC_BYTES (LOCALE_CACHE_SLOTS * (LOCALE_SLOT_BYTES + sizeof(int16_t) + sizeof(uint32_t)) \
+                      + LOCALE_STRING_COUNT)
+#endif
+
+typedef struct {
+    const char *locale;
+    uint32_t resource_id;
+} LocaleCase;
+
+static const LocaleCase cases[] = {
+    { "en_US", RESOURCE_ID_LOCALE_ENGLISH },
+    { "fr_FR", RESOURCE_ID_LOCALE_FRENCH },
+    { "es_ES", RESOURCE_ID_LOCALE_SPANISH },
+    { "de_DE", RESOURCE_ID_LOCALE_GERMAN },
+};
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int session() {
+    int missing = 0;
+    const char *main_window[] = { _("not tracking"), _("with alarm") };
+    for (int i = 0; i < 2; i++)
+        missing += main_window[i][0] == '\7';
+    for (int pass = 0; pass < 2; pass++) {
+        const char *menu[] = {
+            _("Set alarm time"), _("View stats"), _("Clear stats"),
+            _("Fall asleep"), _("Normal"), _("Sensitivity"), _("Normal"),
+            _("Snooze"), _("10 min"), _("Profile"), _("5/2 with alarm"), _("Version"),
+        };
+        for (unsigned i = 0; i < sizeof(menu) / sizeof(menu[0]); i++)
+            missing += menu[i][0] == '\7';
+    }
+    missing += _("not tracking")[0] == '\7';
+    return missing;
+}
+
+static void run_locale(const LocaleCase *c) {
+    sim_reset(0);
+    sim_set_locale(c->locale);
+
+    // Read the file before measuring, the device has it in flash
+    ResHandle handle = resource_get_handle(c->resource_id);
+    int size = resource_size(handle);
+    uint8_t *file = malloc(size);
+    resource_load(handle, file, size);
+    int entries = *(uint32_t *)file;
+    uint32_t *hashes = malloc(entries * sizeof(uint32_t));
+    for (int i = 0; i < entries; i++) {
+        hashes[i] = ((uint32_t *)(file + sizeof(uint32_t)))[2 * i];
+    }
+    int strings_bytes = size - sizeof(uint32_t) - entries * 2 * sizeof(uint32_t);
+    int dict_copy = (size + 7 * entries) + strings_bytes;
+    sim_reset(0);
+
+    size_t heap_before = heap_bytes_used();
+    uint64_t started = now_ns();
+    locale_init();
+    uint64_t init_ns = now_ns() - started;
+    size_t ram = heap_bytes_used() - heap_before + STATIC_BYTES;
+    const SimResourceCounters *rc = sim_resource_counters();
+    uint32_t init_loads = rc->loads;
+    uint32_t init_bytes = rc->bytes;
+
+    int missing = session();
+    uint32_t session_loads = rc->loads - init_loads;
+    uint32_t session_bytes = rc->bytes - init_bytes;
+
+    // Every string by hash and by index - the index must find the same one
+    for (int i = 0; i < entries; i++) {
+        const char *by_id = locale_str_id(locale_id(hashes[i]));
+        if (by_id[0] == '\7' || strcmp(by_id, locale_str(hashes[i])) != 0)
+            missing++;
+    }
+    // Lookups of all strings in turn - the worst case for the cache
+    volatile char sink;
+    started = now_ns();
+    for (int r = 0; r < LOOKUP_ROUNDS; r++) {
+        for (int i = 0; i < entries; i++) {
+            sink = locale_str_id(i)[0];
+        }
+    }
+    (void)sink;
+    uint64_t id_ns = (now_ns() - started) / ((uint64_t)LOOKUP_ROUNDS * entries);
+
+    printf("%-5s %-6s %5d %5d %6u %6u %8.1f %5zu %9d %6u %6u %6lu %7d\n",
+           MODE_NAME, c->locale, entries, size, init_loads, init_bytes, init_ns / 1000.0,
+           ram, dict_copy, session_loads, session_bytes, (unsigned long)id_ns, missing);
+    fflush(stdout);
+    exit(missing ? 1 : 0);
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+    if (argc < 2 || strcmp(argv[1], "-q") != 0) {
+        printf("%-5s %-6s %5s %5s %6s %6s %8s %5s %9s %6s %6s %6s %7s\n",
+               "mode", "locale", "strs", "file", "loads", "bytes", "init[us]", "ram",
+               "dictcopy", "sloads", "sbytes", "id[ns]", "missing");
+    }
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_locale(&cases[i]);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
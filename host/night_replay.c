@@ -0,0 +1,258 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Replays accelerometer traces (accel_trace.h) through the worker on the
+// virtual clock and prints what it made of each night: the stored minute
+// values, the phase of every minute, the phase totals and the minute the
+// alarm went off. The output depends on the traces only, so it can be
+// compared to earlier runs as it is.
+//
+//   night_replay [-q] [-t] [-e] [-c costs] [-w] trace...
+//
+//   -q  one line per night
+//   -t  with the run time, which is not deterministic
+//   -e  with the energy report of the worker (energy.h)
+//   -c  costs of the energy report from a file, implies -e
+//   -w  with the flash writes of the worker: bytes, bytes that changed,
+//       rewrites of the same data and the keys by bytes written
+//
+// Every night runs in its own process, so it starts with the fresh static
+// state of the worker like after a launch.
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pebble.h>
+#include "sim.h"
+#include "constants.h"
+#include "accel_trace.h"
+#include "energy.h"
+
+#define VALUES_PER_LINE 30
+#define HEAT_KEYS 32
+
+int pebslee_worker_main(void);
+
+static bool quiet = false;
+static bool timing = false;
+static bool energy = false;
+static bool writes = false;
+static EnergyCosts costs;
+
+static AccelTrace night;
+static uint8_t phases[MAX_COUNT];
+static int phase_count = 0;
+static int alarm_minute = -1;
+
+static int accel_source(uint64_t now_ms, AccelData *sample) {
+    uint64_t index = now_ms / night.header.sample_ms;
+    if (index >= night.header.samples)
+        return -1;
+    const AccelTraceSample *record = &night.samples[index];
+    sample->x = record->x;
+    sample->y = record->y;
+    sample->z = record->z;
+    sample->did_vibrate = record->did_vibrate;
+    return record->status;
+}
+
+// Plays the app - kept open all night, so every minute comes with its phase
+static void app_receiver(uint8_t type, const AppWorkerMessage *data) {
+    if (type == WORKER_CMD_MINUTE_VALUE) {
+        if (data->data0 >= 1 && data->data0 <= MAX_COUNT) {
+            phases[data->data0 - 1] = data->data2;
+            if (data->data0 > phase_count)
+                phase_count = data->data0;
+        }
+    } else if (type == WORKER_CMD_EXEC_ALARM && alarm_minute < 0) {
+        // The app would ring and stop the worker
+        alarm_minute = sim_now_ms() / 60000;
+        sim_set_event_loop_end(sim_now_ms());
+    }
+}
+
+static void change_utc_offset(void *data) {
+    sim_set_utc_offset(night.header.dst_offset);
+}
+
+static void write_config(const AccelTraceHeader *header) {
+    GlobalConfig config = {
+        .mode = header->mode,
+        .status = STATUS_ACTIVE,
+        .start_wake_hour = header->start_wake_hour,
+        .start_wake_min = header->start_wake_min,
+        .end_wake_hour = header->end_wake_hour,
+        .end_wake_min = header->end_wake_min,
+        .up_coef = header->up_coef,
+        .down_coef = header->down_coef,
+        .active_profile = ACTIVE_PROFILE_NORMAL,
+    };
+    persist_write_data(CONFIG_PERSISTENT_KEY, &config, sizeof(config));
+}
+
+static char phase_letter(int phase) {
+    switch (phase) {
+        case DEEP: return 'D';
+        case REM: return 'R';
+        case LIGHT: return 'L';
+        case AWAKE: return 'A';
+    }
+    return '?';
+}
+
+// Write amplification - bytes written for every byte that changed
+static void print_writes() {
+    const SimPersistCounters *c = sim_persist_counters();
+    printf("writes %u bytes %u changed %u same %u keys %u amplification %.2f\n",
+           c->writes, c->write_bytes, c->changed_bytes, c->unchanged_writes, c->keys_touched,
+           c->changed_bytes ? (double)c->write_bytes / c->changed_bytes : 0.0);
+
+    SimPersistHeat heat[HEAT_KEYS];
+    int keys = sim_persist_heat(heat, HEAT_KEYS);
+    printf("heat");
+    for (int i = 0; i < keys; i++) {
+        printf(" %u:%ux%uB", heat[i].key, heat[i].writes, heat[i].bytes);
+        if (heat[i].unchanged_writes)
+            printf("/%usame", heat[i].unchanged_writes);
+    }
+    printf("\n");
+}
+
+static void print_night(const char *path, double took_ms, const EnergyCounts *counts) {
+    StatData stat;
+    memset(&stat, 0, sizeof(stat));
+    int stats = persist_read_int(COUNT_STATS_KEY);
+    bool stored = stats > 0 && persist_read_data(STAT_START + stats - 1, &stat, sizeof(stat)) == sizeof(stat);
+    int count = stored ? persist_read_int(PERSISTENT_COUNT_KEY) : 0;
+
+    printf("%s minutes %d deep %d rem %d light %d awake %d alarm ", path, count,
+           stat.stat[0], stat.stat[1], stat.stat[2], stat.stat[3]);
+    if (alarm_minute >= 0)
+        printf("%d", alarm_minute);
+    else
+        printf("-");
+    if (timing)
+        printf(" ms %.2f", took_ms);
+    printf("\n");
+    if (energy)
+        energy_print(stdout, counts, &costs);
+    if (writes)
+        print_writes();
+    if (quiet)
+        return;
+
+    // What the phone gets
+    uint8_t chunk[MAX_PERSIST_BUFFER];
+    for (int start = 0; start < count; start += MAX_PERSIST_BUFFER) {
+        int size = MIN(MAX_PERSIST_BUFFER, count - start);
+        persist_read_data(PERSISTENT_VALUES_KEY + start / MAX_PERSIST_BUFFER, chunk, size);
+        for (int i = 0; i < size; i++) {
+            int minute = start + i;
+            printf("%s%d", minute % VALUES_PER_LINE == 0 ? "values " : " ", chunk[i]);
+            if (minute % VALUES_PER_LINE == VALUES_PER_LINE - 1 || minute == count - 1)
+                printf("\n");
+        }
+    }
+
+    // Phases as runs, D12 is 12 minutes of deep sleep
+    printf("phases");
+    for (int i = 0; i < phase_count; ) {
+        int run = 1;
+        while (i + run < phase_count && phases[i + run] == phases[i])
+            run++;
+        printf(" %c%d", phase_letter(phases[i]), run);
+        i += run;
+    }
+    printf("\n");
+}
+
+static void replay(const char *path) {
+    if (!accel_trace_load(path, &night))
+        exit(1);
+
+    sim_reset(night.header.start_time);
+    sim_set_utc_offset(night.header.utc_offset);
+    if (night.header.dst_time > night.header.start_time)
+        sim_schedule((night.header.dst_time - night.header.start_time) * 1000, change_utc_offset, NULL);
+    sim_accel_set_source(accel_source);
+    sim_worker_set_receiver(app_receiver);
+    write_config(&night.header);
+
+    AppWorkerMessage open = { 0 };
+    sim_worker_deliver(APP_CMD_APP_OPEN, &open);
+    sim_set_event_loop_end((uint64_t)night.header.samples * night.header.sample_ms);
+
+    // The setup above is not part of the night
+    sim_persist_reset_counters();
+    EnergyCounts start;
+    energy_collect(&start, NULL);
+    clock_t started = clock();
+    pebslee_worker_main();
+    double took_ms = (clock() - started) * 1000.0 / CLOCKS_PER_SEC;
+    EnergyCounts counts;
+    energy_collect(&counts, &start);
+
+    print_night(path, took_ms, &counts);
+    accel_trace_free(&night);
+    exit(0);
+}
+
+int main(int argc, char **argv) {
+    energy_default_costs(&costs);
+    int first = 1;
+    for (; first < argc && argv[first][0] == '-'; first++) {
+        if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[first], "-t") == 0) {
+            timing = true;
+        } else if (strcmp(argv[first], "-e") == 0) {
+            energy = true;
+        } else if (strcmp(argv[first], "-w") == 0) {
+            writes = true;
+        } else if (strcmp(argv[first], "-c") == 0 && first + 1 < argc) {
+            energy = true;
+            if (!energy_load_costs(argv[++first], &costs))
+                return 2;
+        } else {
+            first = argc;
+        }
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [-q] [-t] [-e] [-c costs] [-w] trace...\n", argv[0]);
+        return 2;
+    }
+
+    int failed = 0;
+    for (int i = first; i < argc; i++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            replay(argv[i]);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
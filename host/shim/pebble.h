@@ -0,0 +1,297 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Minimal stand-in of the Pebble SDK header for building the app and the
+// worker code on Linux. Only the part of the API the app uses is here, with the same
+// names, types and dictionary layout as the SDK. Time is virtual and
+// driven by the event loop in sim.h.
+
+#ifndef PebSlee_host_pebble_h
+#define PebSlee_host_pebble_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ================== Logging ======================
+typedef enum {
+    APP_LOG_LEVEL_ERROR = 1,
+    APP_LOG_LEVEL_WARNING = 50,
+    APP_LOG_LEVEL_INFO = 100,
+    APP_LOG_LEVEL_DEBUG = 200,
+    APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+#define APP_LOG(level, fmt, ...) \
+    fprintf(stderr, "[%d] %s:%d " fmt "\n", level, __FILE__, __LINE__, ##__VA_ARGS__)
+
+// ================== Time ======================
+typedef enum {
+    SECOND_UNIT = 1 << 0,
+    MINUTE_UNIT = 1 << 1,
+    HOUR_UNIT = 1 << 2,
+    DAY_UNIT = 1 << 3,
+    MONTH_UNIT = 1 << 4,
+    YEAR_UNIT = 1 << 5
+} TimeUnits;
+
+time_t sim_time(time_t *tloc);
+#define time(tloc) sim_time(tloc)
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+// The watch runs on local time, see sim_set_utc_offset()
+struct tm *sim_localtime(const time_t *timep);
+#define localtime(timep) sim_localtime(timep)
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+// ================== Timers ======================
+typedef void (*AppTimerCallback)(void *data);
+typedef struct AppTimer AppTimer;
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+// ================== Persistent storage ======================
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+typedef int32_t status_t;
+#define S_SUCCESS 0
+#define E_DOES_NOT_EXIST -10
+#define E_OUT_OF_STORAGE -8
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+status_t persist_delete(const uint32_t key);
+
+// ================== Dictionary ======================
+typedef enum {
+    TUPLE_BYTE_ARRAY = 0,
+    TUPLE_CSTRING = 1,
+    TUPLE_UINT = 2,
+    TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) Tuple {
+    uint32_t key;
+    TupleType type:8;
+    uint16_t length;
+    union {
+        uint8_t data[0];
+        char cstring[0];
+        uint8_t uint8;
+        uint16_t uint16;
+        uint32_t uint32;
+        int8_t int8;
+        int16_t int16;
+        int32_t int32;
+    } value[];
+} Tuple;
+
+struct Dictionary;
+typedef struct Dictionary Dictionary;
+
+typedef struct {
+    Dictionary *dictionary;
+    const void *end;
+    Tuple *cursor;
+} DictionaryIterator;
+
+typedef enum {
+    DICT_OK = 0,
+    DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+    DICT_INVALID_ARGS = 1 << 2,
+    DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+    DICT_MALLOC_FAILED = 1 << 4,
+} DictionaryResult;
+
+typedef struct Tuplet {
+    TupleType type;
+    uint32_t key;
+    union {
+        struct {
+            const uint8_t *data;
+            const uint16_t length;
+        } bytes;
+        struct {
+            const char *data;
+            const uint16_t length;
+        } cstring;
+        struct {
+            uint32_t storage;
+            const uint16_t width;
+        } integer;
+    };
+} Tuplet;
+
+#define IS_SIGNED(var) ((bool)((__typeof__(var))-1 < 0))
+
+#define TupletBytes(_key, _data, _length) \
+    ((const Tuplet) { .type = TUPLE_BYTE_ARRAY, .key = _key, .bytes = { .data = _data, .length = _length }})
+#define TupletCString(_key, _cstring) \
+    ((const Tuplet) { .type = TUPLE_CSTRING, .key = _key, .cstring = { .data = _cstring, .length = _cstring ? strlen(_cstring) + 1 : 0 }})
+#define TupletInteger(_key, _integer) \
+    ((const Tuplet) { .type = IS_SIGNED(_integer) ? TUPLE_INT : TUPLE_UINT, .key = _key, .integer = { .storage = _integer, .width = sizeof(_integer) }})
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+uint32_t dict_size(DictionaryIterator *iter);
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t * const buffer, const uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char * const cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value);
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet * const tuplet);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer, const uint16_t size);
+Tuple *dict_read_next(DictionaryIterator *iter);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+// ================== AppMessage ======================
+typedef enum {
+    APP_MSG_OK = 0,
+    APP_MSG_SEND_TIMEOUT = 1 << 1,
+    APP_MSG_SEND_REJECTED = 1 << 2,
+    APP_MSG_NOT_CONNECTED = 1 << 3,
+    APP_MSG_APP_NOT_RUNNING = 1 << 4,
+    APP_MSG_INVALID_ARGS = 1 << 5,
+    APP_MSG_BUSY = 1 << 6,
+    APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+    APP_MSG_ALREADY_RELEASED = 1 << 9,
+    APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+    APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+    APP_MSG_OUT_OF_MEMORY = 1 << 12,
+    APP_MSG_CLOSED = 1 << 13,
+    APP_MSG_INTERNAL_ERROR = 1 << 14,
+    APP_MSG_INVALID_STATE = 1 << 15,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason, void *context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+void app_message_deregister_callbacks(void);
+
+bool connection_service_peek_pebble_app_connection(void);
+bool bluetooth_connection_service_peek(void);
+
+// ================== Accelerometer ======================
+typedef struct __attribute__((__packed__)) {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    bool did_vibrate;
+    uint64_t timestamp;
+} AccelData;
+
+typedef void (*AccelDataHandler)(AccelData *data, uint32_t num_samples);
+
+typedef enum {
+    ACCEL_SAMPLING_10HZ = 10,
+    ACCEL_SAMPLING_25HZ = 25,
+    ACCEL_SAMPLING_50HZ = 50,
+    ACCEL_SAMPLING_100HZ = 100,
+} AccelSamplingRate;
+
+int accel_service_peek(AccelData *data);
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler);
+void accel_data_service_unsubscribe(void);
+
+// ================== Worker ======================
+typedef enum {
+    APP_WORKER_RESULT_SUCCESS = 0,
+    APP_WORKER_RESULT_NO_WORKER = 1,
+    APP_WORKER_RESULT_DIFFERENT_APP = 2,
+    APP_WORKER_RESULT_NOT_RUNNING = 3,
+    APP_WORKER_RESULT_ALREADY_RUNNING = 4,
+    APP_WORKER_RESULT_ASKING_CONFIRMATION = 5,
+} AppWorkerResult;
+
+typedef struct {
+    uint16_t data0;
+    uint16_t data1;
+    uint16_t data2;
+} AppWorkerMessage;
+
+typedef void (*AppWorkerMessageHandler)(uint16_t type, AppWorkerMessage *data);
+
+bool app_worker_is_running(void);
+AppWorkerResult app_worker_launch(void);
+AppWorkerResult app_worker_kill(void);
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+AppWorkerResult worker_launch_app(void);
+
+// Run the events of the process until sim_set_event_loop_end()
+void app_event_loop(void);
+void worker_event_loop(void);
+
+// ================== Resources ======================
+#include "resource_ids.h"
+
+typedef void *ResHandle;
+
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_size(ResHandle h);
+size_t resource_load(ResHandle h, uint8_t *buffer, size_t max_length);
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+// ================== Memory and locale ======================
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+const char *i18n_get_system_locale(void);
+
+// ================== Vibes and light ======================
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+void light_enable_interaction(void);
+void light_enable(bool enable);
+
+#endif
@@ -0,0 +1,45 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Resource ids in the order of appinfo.json, as the SDK numbers them
+
+#ifndef PebSlee_host_resource_ids_h
+#define PebSlee_host_resource_ids_h
+
+#define RESOURCE_ID_IMAGE_ICON 1
+#define RESOURCE_ID_IMG_ARROW_RIGHT_8X14 2
+#define RESOURCE_ID_IMG_ARROW_LEFT_8X14 3
+#define RESOURCE_ID_IMG_EMPTY_22X25 4
+#define RESOURCE_ID_IMG_CLOCK_WHITE_22X25 5
+#define RESOURCE_ID_IMG_ARROW_RIGHT_BLACK_8X14 6
+#define RESOURCE_ID_IMG_UP_ARROW_BLACK_8X14 7
+#define RESOURCE_ID_IMG_DOWN_ARROW_BLACK_8X14 8
+#define RESOURCE_ID_IMG_SYNC_PROGRESS 9
+#define RESOURCE_ID_IMG_ALARM_BLACK 10
+#define RESOURCE_ID_IMG_ALARM_WHITE 11
+#define RESOURCE_ID_LOCALE_ENGLISH 12
+#define RESOURCE_ID_LOCALE_FRENCH 13
+#define RESOURCE_ID_LOCALE_SPANISH 14
+#define RESOURCE_ID_LOCALE_GERMAN 15
+
+#endif
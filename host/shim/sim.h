@@ -0,0 +1,154 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Control side of the host shim: virtual clock, event queue and the
+// simulated Bluetooth link between the watch app and a phone stand-in.
+
+#ifndef PebSlee_host_sim_h
+#define PebSlee_host_sim_h
+
+#include <pebble.h>
+
+typedef void (*SimEventCallback)(void *data);
+
+// Clears all pending events, storage and link state and sets the wall
+// clock. Virtual time starts at 0 ms.
+void sim_reset(time_t epoch);
+uint64_t sim_now_ms(void);
+void sim_schedule(uint32_t delay_ms, SimEventCallback callback, void *data);
+// Runs the earliest pending event, false when there is none
+bool sim_step(void);
+// Runs events until the queue is empty or the clock passes deadline_ms
+void sim_run_until(uint64_t deadline_ms);
+// Times the CPU woke up for events - events of the same ms are one wakeup
+uint32_t sim_wakeups(void);
+
+// Moves the wall clock to epoch, virtual time and pending events stay
+void sim_set_time(time_t epoch);
+// localtime() is the wall clock plus this, UTC by default
+void sim_set_utc_offset(int32_t seconds);
+// app_event_loop() and worker_event_loop() return when the clock gets here
+void sim_set_event_loop_end(uint64_t end_ms);
+
+// Deterministic random numbers for the fault injection
+void sim_seed(uint32_t seed);
+uint32_t sim_random(void);
+
+typedef struct {
+    uint32_t latency_ms;        // one way
+    uint32_t bytes_per_sec;     // 0 - unlimited
+    uint16_t drop_per_mille;    // lost on air, the watch sees APP_MSG_SEND_TIMEOUT
+    uint16_t busy_per_mille;    // the phone answers with APP_MSG_BUSY
+    uint32_t timeout_ms;        // until a lost message is reported
+    uint32_t inbox_size;        // app_message_inbox_size_maximum()
+    uint32_t outbox_size;       // app_message_outbox_size_maximum()
+    bool connected;
+} SimLink;
+
+typedef struct {
+    uint32_t watch_msgs;        // delivered to the phone
+    uint32_t watch_bytes;
+    uint32_t phone_msgs;        // delivered to the watch
+    uint32_t phone_bytes;
+    uint32_t sends;             // app_message_outbox_send calls
+    uint32_t busy;              // nacked by the phone
+    uint32_t dropped;           // lost on air
+    uint32_t outbox_busy;       // app_message_outbox_begin while in flight
+} SimLinkCounters;
+
+void sim_link_default(SimLink *link);
+void sim_link_set(const SimLink *link);
+const SimLinkCounters *sim_link_counters(void);
+
+// The phone stand-in - gets every message the watch sends and can send
+// its own ones, they arrive after the link latency.
+typedef void (*SimPhoneReceiver)(DictionaryIterator *iter);
+void sim_phone_set_receiver(SimPhoneReceiver receiver);
+void sim_phone_send(const Tuplet *tuplets, int count);
+
+// Accelerometer samples for accel_service_peek() and the data service.
+// The source returns 0, or the -1/-2 peek fails with.
+typedef int (*SimAccelSource)(uint64_t now_ms, AccelData *sample);
+void sim_accel_set_source(SimAccelSource source);
+
+// The other end of app_worker_send_message() - a test plays the app for
+// the worker or the worker for the app. Delivered messages arrive at the
+// subscribed handler as the next event.
+typedef void (*SimWorkerReceiver)(uint8_t type, const AppWorkerMessage *data);
+void sim_worker_set_receiver(SimWorkerReceiver receiver);
+void sim_worker_deliver(uint8_t type, const AppWorkerMessage *data);
+
+typedef struct {
+    uint32_t worker_msgs;       // app_worker_send_message calls
+    uint32_t worker_launches;   // app_worker_launch while not running
+    uint32_t app_launches;      // worker_launch_app calls
+    uint32_t vibes;             // short, long and double pulses
+    uint32_t lights;
+    uint32_t accel_peeks;
+    uint32_t accel_samples;     // delivered by peek or the data service
+    uint32_t accel_on_ms;       // data service subscribed
+    uint32_t vibe_ms;
+    uint32_t light_ms;
+} SimDeviceCounters;
+
+const SimDeviceCounters *sim_device_counters(void);
+
+typedef struct {
+    uint32_t lookups;           // persist_exists and persist_get_size
+    uint32_t reads;
+    uint32_t read_bytes;
+    uint32_t writes;
+    uint32_t write_bytes;
+    uint32_t changed_bytes;     // that differ from what the key held
+    uint32_t unchanged_writes;  // the same data again
+    uint32_t keys_touched;
+    uint32_t deletes;
+} SimPersistCounters;
+
+// Writes of one key
+typedef struct {
+    uint32_t key;
+    uint32_t writes;
+    uint32_t bytes;
+    uint32_t unchanged_writes;
+} SimPersistHeat;
+
+const SimPersistCounters *sim_persist_counters(void);
+// Starts the counting again, the stored data stays
+void sim_persist_reset_counters(void);
+// Keys written so far, the most bytes first, returns how many
+int sim_persist_heat(SimPersistHeat *heat, int max);
+
+// Resources are read from the files named in appinfo.json
+void sim_set_resource_dir(const char *dir);
+// What i18n_get_system_locale() returns, "en_US" by default
+void sim_set_locale(const char *locale);
+
+typedef struct {
+    uint32_t loads;             // resource_load and resource_load_byte_range calls
+    uint32_t bytes;
+} SimResourceCounters;
+
+const SimResourceCounters *sim_resource_counters(void);
+
+#endif
@@ -0,0 +1,305 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// AppMessage over a simulated cfg. One outbound message is in flight at
+// a time like on the watch; the phone stand-in answers with an ack, a
+// nack (APP_MSG_BUSY) or not at all when the message is lost.
+
+#include <pebble.h>
+#include "sim_private.h"
+
+typedef enum {
+    OUTBOX_IDLE,
+    OUTBOX_BEGUN,
+    OUTBOX_IN_FLIGHT,
+} OutboxState;
+
+typedef struct {
+    uint8_t *buffer;
+    uint16_t size;
+} Transit;
+
+static SimLink cfg;
+static SimLinkCounters counters;
+static SimPhoneReceiver phone_receiver = NULL;
+
+static bool opened = false;
+static uint8_t *outbox_buffer = NULL;
+static uint32_t outbox_size = 0;
+static uint32_t inbox_size = 0;
+static DictionaryIterator outbox_iter;
+static OutboxState outbox_state = OUTBOX_IDLE;
+
+static AppMessageInboxReceived inbox_received = NULL;
+static AppMessageInboxDropped inbox_dropped = NULL;
+static AppMessageOutboxSent outbox_sent = NULL;
+static AppMessageOutboxFailed outbox_failed = NULL;
+
+void sim_link_default(SimLink *l) {
+    memset(l, 0, sizeof(SimLink));
+    l->latency_ms = 30;
+    l->bytes_per_sec = 0;
+    l->timeout_ms = 1000;
+    l->inbox_size = 656;
+    l->outbox_size = 656;
+    l->connected = true;
+}
+
+void sim_link_reset(void) {
+    sim_link_default(&cfg);
+    memset(&counters, 0, sizeof(counters));
+    phone_receiver = NULL;
+    opened = false;
+    free(outbox_buffer);
+    outbox_buffer = NULL;
+    outbox_size = 0;
+    inbox_size = 0;
+    outbox_state = OUTBOX_IDLE;
+    app_message_deregister_callbacks();
+}
+
+void sim_link_set(const SimLink *l) {
+    cfg = *l;
+}
+
+const SimLinkCounters *sim_link_counters(void) {
+    return &counters;
+}
+
+void sim_phone_set_receiver(SimPhoneReceiver receiver) {
+    phone_receiver = receiver;
+}
+
+static bool chance(uint16_t per_mille) {
+    return per_mille > 0 && sim_random() % 1000 < per_mille;
+}
+
+static uint32_t air_time(uint32_t bytes) {
+    uint32_t ms = cfg.latency_ms;
+    if (cfg.bytes_per_sec > 0)
+        ms += (bytes * 1000 + cfg.bytes_per_sec - 1) / cfg.bytes_per_sec;
+    return ms;
+}
+
+// Size of a written dictionary, whether dict_write_end was called or not
+static uint16_t written_size(const uint8_t *buffer) {
+    uint32_t size = 1;
+    for (int i = 0; i < buffer[0]; i++) {
+        const Tuple *tuple = (const Tuple *)(buffer + size);
+        size += sizeof(Tuple) + tuple->length;
+    }
+    return size;
+}
+
+static Transit *transit_copy(const uint8_t *buffer, uint16_t size) {
+    Transit *t = malloc(sizeof(Transit));
+    t->buffer = malloc(size);
+    t->size = size;
+    memcpy(t->buffer, buffer, size);
+    return t;
+}
+
+static void transit_free(Transit *t) {
+    free(t->buffer);
+    free(t);
+}
+
+/*
+ * Watch -> phone
+ */
+static void outbox_done(AppMessageResult result) {
+    outbox_state = OUTBOX_IDLE;
+    if (result == APP_MSG_OK) {
+        if (outbox_sent)
+            outbox_sent(&outbox_iter, NULL);
+    } else {
+        if (outbox_failed)
+            outbox_failed(&outbox_iter, result, NULL);
+    }
+}
+
+static void ack_arrived(void *data) {
+    outbox_done(APP_MSG_OK);
+}
+
+static void nack_arrived(void *data) {
+    outbox_done(APP_MSG_BUSY);
+}
+
+static void send_timed_out(void *data) {
+    outbox_done(APP_MSG_SEND_TIMEOUT);
+}
+
+static void not_connected(void *data) {
+    outbox_done(APP_MSG_NOT_CONNECTED);
+}
+
+static void phone_received(void *data) {
+    Transit *t = data;
+    if (chance(cfg.busy_per_mille)) {
+        counters.busy++;
+        sim_schedule(cfg.latency_ms, nack_arrived, NULL);
+    } else {
+        counters.watch_msgs++;
+        counters.watch_bytes += t->size;
+        if (phone_receiver) {
+            DictionaryIterator iter;
+            if (dict_read_begin_from_buffer(&iter, t->buffer, t->size))
+                phone_receiver(&iter);
+        }
+        sim_schedule(cfg.latency_ms, ack_arrived, NULL);
+    }
+    transit_free(t);
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+    if (opened)
+        return APP_MSG_INVALID_STATE;
+    if (size_inbound > cfg.inbox_size || size_outbound > cfg.outbox_size)
+        return APP_MSG_OUT_OF_MEMORY;
+    outbox_buffer = malloc(size_outbound);
+    outbox_size = size_outbound;
+    inbox_size = size_inbound;
+    opened = true;
+    return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+    return cfg.inbox_size;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+    return cfg.outbox_size;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+    if (!opened)
+        return APP_MSG_INVALID_STATE;
+    if (outbox_state == OUTBOX_IN_FLIGHT) {
+        counters.outbox_busy++;
+        return APP_MSG_BUSY;
+    }
+    dict_write_begin(&outbox_iter, outbox_buffer, outbox_size);
+    outbox_state = OUTBOX_BEGUN;
+    *iterator = &outbox_iter;
+    return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+    if (outbox_state == OUTBOX_IN_FLIGHT)
+        return APP_MSG_BUSY;
+    if (outbox_state != OUTBOX_BEGUN)
+        return APP_MSG_INVALID_STATE;
+
+    uint16_t size = written_size(outbox_buffer);
+    outbox_state = OUTBOX_IN_FLIGHT;
+    counters.sends++;
+
+    if (!cfg.connected) {
+        sim_schedule(0, not_connected, NULL);
+    } else if (chance(cfg.drop_per_mille)) {
+        counters.dropped++;
+        sim_schedule(cfg.timeout_ms, send_timed_out, NULL);
+    } else {
+        sim_schedule(air_time(size), phone_received, transit_copy(outbox_buffer, size));
+    }
+    return APP_MSG_OK;
+}
+
+/*
+ * Phone -> watch
+ */
+static void watch_received(void *data) {
+    Transit *t = data;
+    if (!opened || t->size > inbox_size) {
+        if (inbox_dropped)
+            inbox_dropped(opened ? APP_MSG_BUFFER_OVERFLOW : APP_MSG_APP_NOT_RUNNING, NULL);
+    } else {
+        counters.phone_msgs++;
+        counters.phone_bytes += t->size;
+        DictionaryIterator iter;
+        if (dict_read_begin_from_buffer(&iter, t->buffer, t->size) && inbox_received)
+            inbox_received(&iter, NULL);
+    }
+    transit_free(t);
+}
+
+void sim_phone_send(const Tuplet *tuplets, int count) {
+    uint32_t size = 1;
+    for (int i = 0; i < count; i++) {
+        uint16_t length = tuplets[i].type == TUPLE_BYTE_ARRAY ? tuplets[i].bytes.length
+                        : tuplets[i].type == TUPLE_CSTRING ? tuplets[i].cstring.length
+                        : tuplets[i].integer.width;
+        size += sizeof(Tuple) + length;
+    }
+    uint8_t *buffer = malloc(size);
+    DictionaryIterator iter;
+    dict_write_begin(&iter, buffer, size);
+    for (int i = 0; i < count; i++) {
+        dict_write_tuplet(&iter, &tuplets[i]);
+    }
+    dict_write_end(&iter);
+
+    if (cfg.connected)
+        sim_schedule(air_time(size), watch_received, transit_copy(buffer, size));
+    free(buffer);
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+    AppMessageInboxReceived old = inbox_received;
+    inbox_received = received_callback;
+    return old;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+    AppMessageInboxDropped old = inbox_dropped;
+    inbox_dropped = dropped_callback;
+    return old;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+    AppMessageOutboxSent old = outbox_sent;
+    outbox_sent = sent_callback;
+    return old;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+    AppMessageOutboxFailed old = outbox_failed;
+    outbox_failed = failed_callback;
+    return old;
+}
+
+void app_message_deregister_callbacks(void) {
+    inbox_received = NULL;
+    inbox_dropped = NULL;
+    outbox_sent = NULL;
+    outbox_failed = NULL;
+}
+
+bool connection_service_peek_pebble_app_connection(void) {
+    return cfg.connected;
+}
+
+bool bluetooth_connection_service_peek(void) {
+    return cfg.connected;
+}
@@ -0,0 +1,290 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+#include "sim_private.h"
+
+// Few timers are pending at any time, a linear scan is enough
+#define MAX_EVENTS 64
+
+typedef struct {
+    uint64_t when;
+    uint64_t order;             // keeps events of the same time in FIFO order
+    SimEventCallback callback;
+    void *data;
+    uint16_t generation;
+    bool used;
+} SimEvent;
+
+static SimEvent events[MAX_EVENTS];
+static uint64_t now_ms = 0;
+static uint64_t next_order = 0;
+static time_t start_epoch = 0;
+static uint32_t rnd_state = 1;
+static uint64_t loop_end_ms = 0;
+static uint32_t wakeups = 0;
+static uint64_t last_wakeup_ms = 0;
+static int32_t utc_offset = 0;
+
+static TickHandler tick_handler = NULL;
+static TimeUnits tick_units = 0;
+static AppTimer *tick_timer = NULL;
+static struct tm last_tick;
+
+// AppTimer handles are slot and generation, a stale handle never matches
+// a reused slot
+static AppTimer *make_handle(int slot) {
+    return (AppTimer *)(uintptr_t)(((uint32_t)events[slot].generation << 16) | (slot + 1));
+}
+
+static int handle_slot(AppTimer *handle) {
+    uint32_t h = (uint32_t)(uintptr_t)handle;
+    int slot = (int)(h & 0xFFFF) - 1;
+    if (slot < 0 || slot >= MAX_EVENTS)
+        return -1;
+    if (!events[slot].used || events[slot].generation != (h >> 16))
+        return -1;
+    return slot;
+}
+
+static int schedule(uint32_t delay_ms, SimEventCallback callback, void *data) {
+    for (int i = 0; i < MAX_EVENTS; i++) {
+        if (!events[i].used) {
+            events[i].used = true;
+            events[i].when = now_ms + delay_ms;
+            events[i].order = next_order++;
+            events[i].callback = callback;
+            events[i].data = data;
+            events[i].generation++;
+            return i;
+        }
+    }
+    fprintf(stderr, "sim: event queue full\n");
+    abort();
+}
+
+void sim_reset(time_t epoch) {
+    memset(events, 0, sizeof(events));
+    now_ms = 0;
+    next_order = 0;
+    start_epoch = epoch;
+    loop_end_ms = 0;
+    utc_offset = 0;
+    wakeups = 0;
+    tick_handler = NULL;
+    tick_timer = NULL;
+    sim_persist_reset();
+    sim_link_reset();
+    sim_resources_reset();
+    sim_device_reset();
+}
+
+uint64_t sim_now_ms(void) {
+    return now_ms;
+}
+
+uint32_t sim_wakeups(void) {
+    return wakeups;
+}
+
+void sim_schedule(uint32_t delay_ms, SimEventCallback callback, void *data) {
+    schedule(delay_ms, callback, data);
+}
+
+static int next_event(void) {
+    int next = -1;
+    for (int i = 0; i < MAX_EVENTS; i++) {
+        if (!events[i].used)
+            continue;
+        if (next < 0 || events[i].when < events[next].when
+                || (events[i].when == events[next].when && events[i].order < events[next].order))
+            next = i;
+    }
+    return next;
+}
+
+bool sim_step(void) {
+    int next = next_event();
+    if (next < 0)
+        return false;
+    SimEvent ev = events[next];
+    events[next].used = false;
+    if (ev.when > now_ms)
+        now_ms = ev.when;
+    if (wakeups == 0 || now_ms != last_wakeup_ms) {
+        wakeups++;
+        last_wakeup_ms = now_ms;
+    }
+    ev.callback(ev.data);
+    return true;
+}
+
+void sim_run_until(uint64_t deadline_ms) {
+    int next;
+    while ((next = next_event()) >= 0 && events[next].when <= deadline_ms) {
+        sim_step();
+    }
+    if (now_ms < deadline_ms)
+        now_ms = deadline_ms;
+}
+
+void sim_set_time(time_t epoch) {
+    start_epoch = epoch - (time_t)(now_ms / 1000);
+}
+
+void sim_set_utc_offset(int32_t seconds) {
+    utc_offset = seconds;
+}
+
+void sim_set_event_loop_end(uint64_t end_ms) {
+    loop_end_ms = end_ms;
+}
+
+// The end can be moved by the events themselves
+static void run_event_loop(void) {
+    int next;
+    while ((next = next_event()) >= 0 && events[next].when <= loop_end_ms) {
+        sim_step();
+    }
+    if (now_ms < loop_end_ms)
+        now_ms = loop_end_ms;
+}
+
+void app_event_loop(void) {
+    run_event_loop();
+}
+
+void worker_event_loop(void) {
+    run_event_loop();
+}
+
+void sim_seed(uint32_t seed) {
+    rnd_state = seed ? seed : 1;
+}
+
+uint32_t sim_random(void) {
+    // xorshift32
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+/*
+ * Time
+ */
+time_t sim_time(time_t *tloc) {
+    time_t t = start_epoch + (time_t)(now_ms / 1000);
+    if (tloc)
+        *tloc = t;
+    return t;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+    uint16_t ms = now_ms % 1000;
+    sim_time(tloc);
+    if (out_ms)
+        *out_ms = ms;
+    return ms;
+}
+
+struct tm *sim_localtime(const time_t *timep) {
+    static struct tm result;
+    time_t local = *timep + utc_offset;
+    return gmtime_r(&local, &result);
+}
+
+/*
+ * Tick timer service - fires on the wall clock boundaries of the unit
+ */
+static uint32_t ms_to_next_tick(void) {
+    // Boundaries of the local time, hours can be offset by 30 minutes
+    time_t t = sim_time(NULL) + utc_offset;
+    uint32_t period = 1;
+    if (!(tick_units & SECOND_UNIT))
+        period = (tick_units & MINUTE_UNIT) ? 60 : (tick_units & HOUR_UNIT) ? 3600 : 86400;
+    return (period - (uint32_t)(t % period)) * 1000 - (uint32_t)(now_ms % 1000);
+}
+
+static void tick_callback(void *data) {
+    time_t t = sim_time(NULL);
+    struct tm now = *sim_localtime(&t);
+    TimeUnits changed = 0;
+    if (now.tm_sec != last_tick.tm_sec)
+        changed |= SECOND_UNIT;
+    if (now.tm_min != last_tick.tm_min)
+        changed |= MINUTE_UNIT;
+    if (now.tm_hour != last_tick.tm_hour)
+        changed |= HOUR_UNIT;
+    if (now.tm_mday != last_tick.tm_mday)
+        changed |= DAY_UNIT;
+    if (now.tm_mon != last_tick.tm_mon)
+        changed |= MONTH_UNIT;
+    if (now.tm_year != last_tick.tm_year)
+        changed |= YEAR_UNIT;
+    last_tick = now;
+
+    tick_timer = make_handle(schedule(ms_to_next_tick(), tick_callback, NULL));
+    if (changed & tick_units)
+        tick_handler(&now, changed);
+}
+
+void tick_timer_service_subscribe(TimeUnits units, TickHandler handler) {
+    tick_timer_service_unsubscribe();
+    if (handler == NULL || units == 0)
+        return;
+    time_t t = sim_time(NULL);
+    last_tick = *sim_localtime(&t);
+    tick_handler = handler;
+    tick_units = units;
+    tick_timer = make_handle(schedule(ms_to_next_tick(), tick_callback, NULL));
+}
+
+void tick_timer_service_unsubscribe(void) {
+    if (tick_timer)
+        app_timer_cancel(tick_timer);
+    tick_timer = NULL;
+    tick_handler = NULL;
+}
+
+/*
+ * Timers
+ */
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+    return make_handle(schedule(timeout_ms, callback, callback_data));
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+    int slot = handle_slot(timer_handle);
+    if (slot < 0)
+        return false;
+    events[slot].when = now_ms + new_timeout_ms;
+    events[slot].order = next_order++;
+    return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+    int slot = handle_slot(timer_handle);
+    if (slot >= 0)
+        events[slot].used = false;
+}
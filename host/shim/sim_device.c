@@ -0,0 +1,258 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Worker link, accelerometer, vibration and backlight. Vibrations and
+// the light only count, the accelerometer and the other end of the
+// worker messages are played by the test.
+
+#include <pebble.h>
+#include "sim_private.h"
+
+static SimDeviceCounters counters;
+static bool worker_running = false;
+static AppWorkerMessageHandler worker_handler = NULL;
+static SimWorkerReceiver worker_receiver = NULL;
+
+static SimAccelSource accel_source = NULL;
+static AccelSamplingRate accel_rate = ACCEL_SAMPLING_25HZ;
+static AccelDataHandler accel_handler = NULL;
+static uint32_t accel_batch = 0;
+// Bumped on unsubscribe, so a pending batch of the old subscription is dropped
+static uintptr_t accel_generation = 0;
+static bool accel_on = false;
+static uint64_t accel_on_since = 0;
+
+// Lengths of the firmware vibration patterns and the backlight timeout
+#define VIBE_SHORT_MS 200
+#define VIBE_LONG_MS 500
+#define LIGHT_INTERACTION_MS 3000
+
+static uint64_t light_until = 0;
+static bool light_on = false;
+static uint64_t light_on_since = 0;
+
+void sim_device_reset(void) {
+    memset(&counters, 0, sizeof(counters));
+    worker_running = false;
+    worker_handler = NULL;
+    worker_receiver = NULL;
+    accel_source = NULL;
+    accel_rate = ACCEL_SAMPLING_25HZ;
+    accel_handler = NULL;
+    accel_batch = 0;
+    accel_generation++;
+    accel_on = false;
+    light_until = 0;
+    light_on = false;
+}
+
+const SimDeviceCounters *sim_device_counters(void) {
+    // Account what is still on up to now
+    uint64_t now = sim_now_ms();
+    if (accel_on) {
+        counters.accel_on_ms += now - accel_on_since;
+        accel_on_since = now;
+    }
+    if (light_on) {
+        counters.light_ms += now - light_on_since;
+        light_on_since = now;
+    }
+    return &counters;
+}
+
+/*
+ * Worker messages
+ */
+bool app_worker_is_running(void) {
+    return worker_running;
+}
+
+AppWorkerResult app_worker_launch(void) {
+    if (worker_running)
+        return APP_WORKER_RESULT_ALREADY_RUNNING;
+    worker_running = true;
+    counters.worker_launches++;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult app_worker_kill(void) {
+    if (!worker_running)
+        return APP_WORKER_RESULT_NOT_RUNNING;
+    worker_running = false;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult worker_launch_app(void) {
+    counters.app_launches++;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler) {
+    worker_handler = handler;
+    return true;
+}
+
+bool app_worker_message_unsubscribe(void) {
+    worker_handler = NULL;
+    return true;
+}
+
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data) {
+    counters.worker_msgs++;
+    if (worker_receiver)
+        worker_receiver(type, data);
+}
+
+void sim_worker_set_receiver(SimWorkerReceiver receiver) {
+    worker_receiver = receiver;
+}
+
+typedef struct {
+    uint16_t type;
+    AppWorkerMessage data;
+} PendingWorkerMessage;
+
+static void deliver_worker_message(void *data) {
+    PendingWorkerMessage *msg = data;
+    if (worker_handler)
+        worker_handler(msg->type, &msg->data);
+    free(msg);
+}
+
+void sim_worker_deliver(uint8_t type, const AppWorkerMessage *data) {
+    PendingWorkerMessage *msg = malloc(sizeof(PendingWorkerMessage));
+    msg->type = type;
+    msg->data = *data;
+    sim_schedule(0, deliver_worker_message, msg);
+}
+
+/*
+ * Accelerometer
+ */
+void sim_accel_set_source(SimAccelSource source) {
+    accel_source = source;
+}
+
+static int accel_sample(AccelData *data) {
+    memset(data, 0, sizeof(AccelData));
+    if (accel_source == NULL)
+        return -1;
+    int result = accel_source(sim_now_ms(), data);
+    time_t sec;
+    uint16_t ms;
+    time_ms(&sec, &ms);
+    data->timestamp = (uint64_t)sec * 1000 + ms;
+    if (result == 0)
+        counters.accel_samples++;
+    return result;
+}
+
+int accel_service_peek(AccelData *data) {
+    counters.accel_peeks++;
+    // Same as the device - no peeking while the data service delivers
+    if (accel_handler)
+        return -2;
+    return accel_sample(data);
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate) {
+    accel_rate = rate;
+    return 0;
+}
+
+static uint32_t batch_ms(void) {
+    return accel_batch * 1000 / accel_rate;
+}
+
+static void accel_batch_callback(void *data) {
+    if ((uintptr_t)data != accel_generation || accel_handler == NULL)
+        return;
+    AccelData samples[accel_batch];
+    uint32_t count = 0;
+    while (count < accel_batch && accel_sample(&samples[count]) == 0)
+        count++;
+    sim_schedule(batch_ms(), accel_batch_callback, data);
+    if (count > 0)
+        accel_handler(samples, count);
+}
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler) {
+    accel_data_service_unsubscribe();
+    accel_on = true;
+    accel_on_since = sim_now_ms();
+    if (handler == NULL || samples_per_update == 0)
+        return;
+    accel_handler = handler;
+    accel_batch = samples_per_update;
+    sim_schedule(batch_ms(), accel_batch_callback, (void *)accel_generation);
+}
+
+void accel_data_service_unsubscribe(void) {
+    accel_generation++;
+    accel_handler = NULL;
+    if (accel_on)
+        counters.accel_on_ms += sim_now_ms() - accel_on_since;
+    accel_on = false;
+}
+
+/*
+ * Vibes and light
+ */
+void vibes_short_pulse(void) {
+    counters.vibes++;
+    counters.vibe_ms += VIBE_SHORT_MS;
+}
+
+void vibes_long_pulse(void) {
+    counters.vibes++;
+    counters.vibe_ms += VIBE_LONG_MS;
+}
+
+void vibes_double_pulse(void) {
+    counters.vibes++;
+    counters.vibe_ms += 2 * VIBE_SHORT_MS;
+}
+
+void light_enable_interaction(void) {
+    counters.lights++;
+    if (light_on)
+        return;
+    // Extends a light that is still on
+    uint64_t now = sim_now_ms();
+    uint64_t from = light_until > now ? light_until : now;
+    counters.light_ms += now + LIGHT_INTERACTION_MS - from;
+    light_until = now + LIGHT_INTERACTION_MS;
+}
+
+void light_enable(bool enable) {
+    uint64_t now = sim_now_ms();
+    if (enable && !light_on) {
+        counters.lights++;
+        light_on = true;
+        light_on_since = now;
+    } else if (!enable && light_on) {
+        counters.light_ms += now - light_on_since;
+        light_on = false;
+    }
+}
@@ -0,0 +1,167 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Dictionary with the SDK byte layout: one byte tuple count followed by
+// the tuples, each a 7 byte header (key, type, length) and the value.
+
+#include <stdarg.h>
+#include <pebble.h>
+
+struct __attribute__((__packed__)) Dictionary {
+    uint8_t count;
+    Tuple head[];
+};
+
+#define TUPLE_HEADER_SIZE sizeof(Tuple)
+
+static Tuple *next_tuple(Tuple *tuple) {
+    return (Tuple *)((uint8_t *)tuple + TUPLE_HEADER_SIZE + tuple->length);
+}
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+    uint32_t size = sizeof(Dictionary);
+    va_list args;
+    va_start(args, tuple_count);
+    for (int i = 0; i < tuple_count; i++) {
+        size += TUPLE_HEADER_SIZE + va_arg(args, uint32_t);
+    }
+    va_end(args);
+    return size;
+}
+
+uint32_t dict_size(DictionaryIterator *iter) {
+    return (uint32_t)((uint8_t *)iter->end - (uint8_t *)iter->dictionary);
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t * const buffer, const uint16_t size) {
+    if (iter == NULL || buffer == NULL)
+        return DICT_INVALID_ARGS;
+    if (size < sizeof(Dictionary))
+        return DICT_NOT_ENOUGH_STORAGE;
+    iter->dictionary = (Dictionary *)buffer;
+    iter->dictionary->count = 0;
+    iter->end = buffer + size;
+    iter->cursor = iter->dictionary->head;
+    return DICT_OK;
+}
+
+static DictionaryResult write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type,
+        const void *data, uint16_t length) {
+    if (iter == NULL || iter->dictionary == NULL)
+        return DICT_INVALID_ARGS;
+    if ((uint8_t *)iter->cursor + TUPLE_HEADER_SIZE + length > (uint8_t *)iter->end)
+        return DICT_NOT_ENOUGH_STORAGE;
+    iter->cursor->key = key;
+    iter->cursor->type = type;
+    iter->cursor->length = length;
+    if (length > 0)
+        memcpy(iter->cursor->value->data, data, length);
+    iter->cursor = next_tuple(iter->cursor);
+    iter->dictionary->count++;
+    return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data, const uint16_t size) {
+    return write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char * const cstring) {
+    uint16_t length = cstring ? strlen(cstring) + 1 : 0;
+    return write_tuple(iter, key, TUPLE_CSTRING, cstring, length);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed) {
+    if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4)
+        return DICT_INVALID_ARGS;
+    return write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+    return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+    return dict_write_int(iter, key, &value, 2, false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+    return dict_write_int(iter, key, &value, 4, false);
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet * const tuplet) {
+    switch (tuplet->type) {
+        case TUPLE_BYTE_ARRAY:
+            return dict_write_data(iter, tuplet->key, tuplet->bytes.data, tuplet->bytes.length);
+        case TUPLE_CSTRING:
+            return write_tuple(iter, tuplet->key, TUPLE_CSTRING, tuplet->cstring.data, tuplet->cstring.length);
+        case TUPLE_UINT:
+        case TUPLE_INT:
+            // Little endian host - the low bytes of the storage are the value
+            return dict_write_int(iter, tuplet->key, &tuplet->integer.storage, tuplet->integer.width,
+                                  tuplet->type == TUPLE_INT);
+    }
+    return DICT_INVALID_ARGS;
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+    if (iter == NULL || iter->dictionary == NULL)
+        return 0;
+    iter->end = iter->cursor;
+    iter->cursor = iter->dictionary->head;
+    return dict_size(iter);
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer, const uint16_t size) {
+    if (iter == NULL || buffer == NULL || size < sizeof(Dictionary))
+        return NULL;
+    iter->dictionary = (Dictionary *)buffer;
+    iter->end = buffer + size;
+    return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+    iter->cursor = iter->dictionary->head;
+    if (iter->dictionary->count == 0 || (uint8_t *)iter->cursor + TUPLE_HEADER_SIZE > (uint8_t *)iter->end)
+        return NULL;
+    return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+    Tuple *next = next_tuple(iter->cursor);
+    if ((uint8_t *)next + TUPLE_HEADER_SIZE > (uint8_t *)iter->end)
+        return NULL;
+    iter->cursor = next;
+    return next;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+    Tuple *tuple = iter->dictionary->head;
+    for (int i = 0; i < iter->dictionary->count; i++) {
+        if ((uint8_t *)tuple + TUPLE_HEADER_SIZE > (uint8_t *)iter->end)
+            break;
+        if (tuple->key == key)
+            return tuple;
+        tuple = next_tuple(tuple);
+    }
+    return NULL;
+}
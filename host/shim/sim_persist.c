@@ -0,0 +1,196 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Persistent storage in RAM with the device limits: 256 bytes per key
+// and 4 KB per app.
+
+#include <pebble.h>
+#include "sim_private.h"
+
+#define MAX_KEYS 128
+#define PERSIST_TOTAL_MAX 4096
+
+typedef struct {
+    uint32_t key;
+    uint16_t size;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+    bool used;
+} PersistEntry;
+
+static PersistEntry entries[MAX_KEYS];
+static SimPersistCounters counters;
+static SimPersistHeat heat[MAX_KEYS];
+
+void sim_persist_reset_counters(void) {
+    memset(&counters, 0, sizeof(counters));
+    memset(heat, 0, sizeof(heat));
+}
+
+void sim_persist_reset(void) {
+    memset(entries, 0, sizeof(entries));
+    sim_persist_reset_counters();
+}
+
+const SimPersistCounters *sim_persist_counters(void) {
+    return &counters;
+}
+
+static int by_bytes(const void *a, const void *b) {
+    const SimPersistHeat *ha = a;
+    const SimPersistHeat *hb = b;
+    if (ha->bytes != hb->bytes)
+        return ha->bytes < hb->bytes ? 1 : -1;
+    return ha->key < hb->key ? -1 : ha->key > hb->key;
+}
+
+int sim_persist_heat(SimPersistHeat *out, int max) {
+    int count = max < (int)counters.keys_touched ? max : (int)counters.keys_touched;
+    SimPersistHeat sorted[MAX_KEYS];
+    memcpy(sorted, heat, sizeof(SimPersistHeat) * counters.keys_touched);
+    qsort(sorted, counters.keys_touched, sizeof(SimPersistHeat), by_bytes);
+    memcpy(out, sorted, sizeof(SimPersistHeat) * count);
+    return count;
+}
+
+static void account_write(uint32_t key, const PersistEntry *old, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    uint32_t changed = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (old == NULL || i >= old->size || old->data[i] != bytes[i])
+            changed++;
+    }
+    bool unchanged = old != NULL && changed == 0 && old->size == size;
+
+    SimPersistHeat *key_heat = NULL;
+    for (uint32_t i = 0; i < counters.keys_touched && key_heat == NULL; i++) {
+        if (heat[i].key == key)
+            key_heat = &heat[i];
+    }
+    if (key_heat == NULL && counters.keys_touched < MAX_KEYS) {
+        key_heat = &heat[counters.keys_touched++];
+        key_heat->key = key;
+    }
+
+    counters.writes++;
+    counters.write_bytes += size;
+    counters.changed_bytes += changed;
+    if (unchanged)
+        counters.unchanged_writes++;
+    if (key_heat) {
+        key_heat->writes++;
+        key_heat->bytes += size;
+        if (unchanged)
+            key_heat->unchanged_writes++;
+    }
+}
+
+static PersistEntry *find(uint32_t key) {
+    for (int i = 0; i < MAX_KEYS; i++) {
+        if (entries[i].used && entries[i].key == key)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+static int used_bytes(void) {
+    int total = 0;
+    for (int i = 0; i < MAX_KEYS; i++) {
+        if (entries[i].used)
+            total += entries[i].size;
+    }
+    return total;
+}
+
+static PersistEntry *store(uint32_t key, const void *data, size_t size) {
+    if (size > PERSIST_DATA_MAX_LENGTH)
+        size = PERSIST_DATA_MAX_LENGTH;
+    PersistEntry *entry = find(key);
+    account_write(key, entry, data, size);
+    int free_bytes = PERSIST_TOTAL_MAX - used_bytes() + (entry ? entry->size : 0);
+    if ((int)size > free_bytes)
+        return NULL;
+    if (entry == NULL) {
+        for (int i = 0; i < MAX_KEYS && entry == NULL; i++) {
+            if (!entries[i].used)
+                entry = &entries[i];
+        }
+        if (entry == NULL)
+            return NULL;
+    }
+    entry->used = true;
+    entry->key = key;
+    entry->size = size;
+    memcpy(entry->data, data, size);
+    return entry;
+}
+
+bool persist_exists(const uint32_t key) {
+    counters.lookups++;
+    return find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+    counters.lookups++;
+    PersistEntry *entry = find(key);
+    return entry ? entry->size : E_DOES_NOT_EXIST;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+    PersistEntry *entry = find(key);
+    int32_t value = 0;
+    counters.reads++;
+    if (entry) {
+        memcpy(&value, entry->data, entry->size < sizeof(value) ? entry->size : sizeof(value));
+        counters.read_bytes += sizeof(value);
+    }
+    return value;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+    PersistEntry *entry = find(key);
+    counters.reads++;
+    if (entry == NULL)
+        return E_DOES_NOT_EXIST;
+    size_t size = entry->size < buffer_size ? entry->size : buffer_size;
+    memcpy(buffer, entry->data, size);
+    counters.read_bytes += size;
+    return size;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+    return store(key, &value, sizeof(value)) ? S_SUCCESS : E_OUT_OF_STORAGE;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+    PersistEntry *entry = store(key, data, size);
+    return entry ? entry->size : E_OUT_OF_STORAGE;
+}
+
+status_t persist_delete(const uint32_t key) {
+    PersistEntry *entry = find(key);
+    counters.deletes++;
+    if (entry == NULL)
+        return E_DOES_NOT_EXIST;
+    entry->used = false;
+    return S_SUCCESS;
+}
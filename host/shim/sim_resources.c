@@ -0,0 +1,139 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Resource files of appinfo.json, loaded from disk on first use
+
+#include <malloc.h>
+#include <pebble.h>
+#include "sim_private.h"
+
+static const char *resource_files[] = {
+    "images/icon.png",
+    "images/arrow_right_8x14.png",
+    "images/arrow_left_8x14.png",
+    "images/icon-empty-22x25.png",
+    "images/icon-clock-white-22x25.png",
+    "images/arrow_right_black_8x14.png",
+    "images/arrow_up_black_8x14.png",
+    "images/arrow_down_black_8x14.png",
+    "images/sync-progress.png",
+    "images/alarm_black.png",
+    "images/alarm_white.png",
+    "locale_english.bin",
+    "locale_french.bin",
+    "locale_spanish.bin",
+    "locale_german.bin",
+};
+
+#define RESOURCE_COUNT (sizeof(resource_files) / sizeof(resource_files[0]))
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    bool loaded;
+} SimResource;
+
+static SimResource resources[RESOURCE_COUNT];
+static const char *resource_dir = "../resources";
+static const char *system_locale = "en_US";
+static SimResourceCounters counters;
+
+void sim_set_resource_dir(const char *dir) {
+    resource_dir = dir;
+}
+
+void sim_set_locale(const char *locale) {
+    system_locale = locale;
+}
+
+const SimResourceCounters *sim_resource_counters(void) {
+    return &counters;
+}
+
+void sim_resources_reset(void) {
+    memset(&counters, 0, sizeof(counters));
+}
+
+static SimResource *get(ResHandle h) {
+    uint32_t id = (uint32_t)(uintptr_t)h;
+    if (id < 1 || id > RESOURCE_COUNT)
+        return NULL;
+    SimResource *res = &resources[id - 1];
+    if (!res->loaded) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", resource_dir, resource_files[id - 1]);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            fprintf(stderr, "sim: no resource %s\n", path);
+            abort();
+        }
+        fseek(f, 0, SEEK_END);
+        res->size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        res->data = malloc(res->size ? res->size : 1);
+        if (fread(res->data, 1, res->size, f) != res->size)
+            abort();
+        fclose(f);
+        res->loaded = true;
+    }
+    return res;
+}
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+    return (ResHandle)(uintptr_t)resource_id;
+}
+
+size_t resource_size(ResHandle h) {
+    SimResource *res = get(h);
+    return res ? res->size : 0;
+}
+
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes) {
+    SimResource *res = get(h);
+    if (res == NULL || start_offset >= res->size)
+        return 0;
+    size_t size = res->size - start_offset < num_bytes ? res->size - start_offset : num_bytes;
+    memcpy(buffer, res->data + start_offset, size);
+    counters.loads++;
+    counters.bytes += size;
+    return size;
+}
+
+size_t resource_load(ResHandle h, uint8_t *buffer, size_t max_length) {
+    return resource_load_byte_range(h, 0, buffer, max_length);
+}
+
+const char *i18n_get_system_locale(void) {
+    return system_locale;
+}
+
+/*
+ * Heap of the process - only differences are meaningful
+ */
+size_t heap_bytes_used(void) {
+    return mallinfo2().uordblks;
+}
+
+size_t heap_bytes_free(void) {
+    return mallinfo2().fordblks;
+}
@@ -0,0 +1,467 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Sync benchmark: runs src/comm.c against a phone stand-in over the
+// simulated link and reports the end-to-end sync time and the message
+// counts for each link and protocol scenario.
+//
+// Every scenario runs in its own process, so it starts with the fresh
+// static state of the app like after a launch.
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <pebble.h>
+#include "sim.h"
+#include "comm.h"
+#include "logic.h"
+#include "sync_codec.h"
+#include "sync_metrics.h"
+#include "energy.h"
+
+#define SIM_EPOCH 1420092000
+#define NIGHTS 5
+#define NIGHT_VALUES 600
+// The phone had the nights up to this one before
+#define PHONE_HWM 2
+// Phone asks again when nothing came for this long
+#define PHONE_RESUME_MS 8000
+#define PHONE_CHECK_MS 1000
+#define SYNC_DEADLINE_MS (30 * 60 * 1000)
+// A settings change comes in while the sync is running
+#define PHONE_COMMAND_MS 3500
+#define PHONE_COMMAND_ID 1
+// In the queue scenario a second START_SYNC comes first, the settings
+// behind it must not wait for the end of the sync
+#define PHONE_SETTINGS_DELAY_MS 200
+
+typedef enum {
+    PROTOCOL_LEGACY,        // START_SYNC only, the last night in raw values
+    PROTOCOL_RAW,           // with high-water mark, raw values
+    PROTOCOL_DELTA_RLE,     // with high-water mark, encoded values
+} Protocol;
+
+typedef struct {
+    const char *name;
+    uint32_t latency_ms;
+    uint32_t bytes_per_sec;
+    uint16_t drop_per_mille;
+    uint16_t busy_per_mille;
+} LinkProfile;
+
+static const LinkProfile profiles[] = {
+    { "ideal", 30, 0, 0, 0 },
+    { "slow", 120, 2000, 0, 0 },
+    { "lossy", 30, 0, 50, 0 },
+    { "busy", 30, 0, 0, 100 },
+    { "flaky", 80, 4000, 30, 80 },
+};
+
+static const char *protocol_names[] = { "legacy", "raw+hwm", "delta+hwm" };
+
+static uint8_t night_values[NIGHT_VALUES];
+
+// ================== Phone stand-in ======================
+static struct {
+    Protocol protocol;
+    bool queued;
+    uint32_t hwm;
+    bool header;
+    uint32_t seq;
+    int count;
+    int encoding;
+    int encoded_size;
+    uint8_t values[MAX_COUNT];
+    bool got[MAX_COUNT];
+    uint8_t encoded[SYNC_CODEC_MAX_SIZE(MAX_COUNT)];
+    int encoded_received;
+    int headers;
+    int restarts;
+    bool done;
+    bool verified;
+    uint64_t started_ms;
+    uint64_t done_ms;
+    uint64_t last_rx_ms;
+    uint64_t command_ms;
+    uint64_t ack_ms;
+} phone;
+
+static int decode_delta_rle(const uint8_t *data, int size, uint8_t *values, int max_values) {
+    int count = 0;
+    int prev = 0;
+    int pos = 0;
+    while (pos < size) {
+        uint32_t token = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            if (pos >= size)
+                return -1;
+            b = data[pos++];
+            token |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        if (token == 0) {
+            uint32_t run = 0;
+            shift = 0;
+            do {
+                if (pos >= size)
+                    return -1;
+                b = data[pos++];
+                run |= (uint32_t)(b & 0x7F) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            for (uint32_t i = 0; i < run && count < max_values; i++)
+                values[count++] = prev;
+        } else {
+            prev += (int)(token >> 1) ^ -(int)(token & 1);
+            if (prev < 0 || prev > 255 || count >= max_values)
+                return -1;
+            values[count++] = prev;
+        }
+    }
+    return count;
+}
+
+static int contiguous_values() {
+    int n = 0;
+    while (n < phone.count && phone.got[n])
+        n++;
+    return n;
+}
+
+static bool night_complete() {
+    if (phone.encoding == PS_SYNC_ENCODING_DELTA_RLE)
+        return phone.encoded_received >= phone.encoded_size;
+    return contiguous_values() >= phone.count;
+}
+
+static void verify_night() {
+    if (phone.count != NIGHT_VALUES)
+        return;
+    if (phone.encoding == PS_SYNC_ENCODING_DELTA_RLE) {
+        int n = decode_delta_rle(phone.encoded, phone.encoded_size, phone.values, MAX_COUNT);
+        phone.verified = n == NIGHT_VALUES && memcmp(phone.values, night_values, n) == 0;
+    } else {
+        phone.verified = memcmp(phone.values, night_values, NIGHT_VALUES) == 0;
+    }
+}
+
+static void phone_finish() {
+    // A sync queued behind this one may end again
+    if (phone.done)
+        return;
+    phone.done = true;
+    phone.done_ms = sim_now_ms();
+}
+
+static void phone_receive(DictionaryIterator *iter) {
+    phone.last_rx_ms = sim_now_ms();
+
+    Tuple *acks = dict_find(iter, PS_APP_MSG_COMMAND_ACKS);
+    if (acks) {
+        const uint8_t *pairs = acks->value->data;
+        for (int i = 0; i + 1 < acks->length; i += 2) {
+            if (pairs[i] == PHONE_COMMAND_ID && phone.ack_ms == 0)
+                phone.ack_ms = sim_now_ms();
+        }
+        return;
+    }
+
+    Tuple *done = dict_find(iter, PS_APP_MSG_SYNC_DONE);
+    if (done) {
+        phone.hwm = done->value->uint32;
+        phone_finish();
+        return;
+    }
+
+    Tuple *start = dict_find(iter, PS_APP_MSG_HEADER_START);
+    Tuple *count = dict_find(iter, PS_APP_MSG_HEADER_COUNT);
+    if (start && count) {
+        Tuple *encoding = dict_find(iter, PS_APP_MSG_HEADER_ENCODING);
+        Tuple *size = dict_find(iter, PS_APP_MSG_HEADER_ENCODED_SIZE);
+        Tuple *seq = dict_find(iter, PS_APP_MSG_HEADER_SEQ);
+        Tuple *offset = dict_find(iter, PS_APP_MSG_HEADER_OFFSET);
+        uint32_t night = seq ? seq->value->uint32 : NIGHTS;
+        bool resumed = offset && offset->value->uint16 > 0 && night == phone.seq;
+
+        phone.header = true;
+        phone.headers++;
+        phone.seq = night;
+        phone.count = count->value->uint16;
+        phone.encoding = encoding ? encoding->value->uint8 : PS_SYNC_ENCODING_RAW;
+        phone.encoded_size = size ? size->value->uint16 : 0;
+        if (!resumed) {
+            memset(phone.got, 0, sizeof(phone.got));
+            phone.encoded_received = 0;
+        }
+        if (phone.protocol == PROTOCOL_LEGACY && night_complete()) {
+            verify_night();
+            phone_finish();
+        }
+        return;
+    }
+
+    Tuple *data_offset = dict_find(iter, PS_APP_MSG_DATA_OFFSET);
+    Tuple *data = dict_find(iter, PS_APP_MSG_DATA_BYTES);
+    if (data_offset && data) {
+        int offset = data_offset->value->uint16;
+        if (offset <= phone.encoded_received && offset + data->length <= (int)sizeof(phone.encoded)) {
+            memcpy(&phone.encoded[offset], data->value->data, data->length);
+            phone.encoded_received = offset + data->length;
+        }
+    } else {
+        for (Tuple *t = dict_read_first(iter); t != NULL; t = dict_read_next(iter)) {
+            int index = t->key - 3;
+            if (index >= 0 && index < phone.count) {
+                phone.values[index] = t->value->uint8;
+                phone.got[index] = true;
+            }
+        }
+    }
+
+    if (phone.header && night_complete() && phone.seq == NIGHTS) {
+        verify_night();
+        if (phone.protocol == PROTOCOL_LEGACY)
+            phone_finish();
+    }
+}
+
+static void phone_request_sync() {
+    if (phone.protocol == PROTOCOL_LEGACY) {
+        Tuplet command = TupletInteger(PS_APP_TO_WATCH_COMMAND, (uint8_t)PS_APP_MESSAGE_COMMAND_START_SYNC);
+        sim_phone_send(&command, 1);
+        return;
+    }
+    // Resume in the night that was cut off
+    uint32_t hwm = phone.hwm;
+    uint32_t offset = 0;
+    if (phone.header && phone.seq > phone.hwm) {
+        hwm = phone.seq - 1;
+        offset = phone.encoding == PS_SYNC_ENCODING_DELTA_RLE ? phone.encoded_received : contiguous_values();
+    }
+    Tuplet tuplets[] = {
+        TupletInteger(PS_APP_TO_WATCH_COMMAND, (uint8_t)PS_APP_MESSAGE_COMMAND_START_SYNC),
+        TupletInteger(PS_APP_TO_WATCH_SYNC_ENCODING, (uint8_t)(phone.protocol == PROTOCOL_DELTA_RLE
+                ? PS_SYNC_ENCODING_DELTA_RLE : PS_SYNC_ENCODING_RAW)),
+        TupletInteger(PS_APP_TO_WATCH_SYNC_HWM, hwm),
+        TupletInteger(PS_APP_TO_WATCH_SYNC_OFFSET, offset),
+    };
+    sim_phone_send(tuplets, 4);
+}
+
+static void phone_send_settings(void *data) {
+    Tuplet tuplets[] = {
+        TupletInteger(PS_APP_TO_WATCH_COMMAND, (uint8_t)PS_APP_MESSAGE_COMMAND_SET_SETTINGS),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND_ID, (uint8_t)PHONE_COMMAND_ID),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND + 1, (uint8_t)5),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND + 2, (uint8_t)10),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND + 3, (uint8_t)10),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND + 4, (uint8_t)0),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND + 5, (uint8_t)1),
+    };
+    phone.command_ms = sim_now_ms();
+    sim_phone_send(tuplets, 7);
+}
+
+static void phone_send_command(void *data) {
+    if (phone.queued) {
+        // As the phone does when it thinks the sync got lost
+        phone_request_sync();
+        sim_schedule(PHONE_SETTINGS_DELAY_MS, phone_send_settings, NULL);
+        return;
+    }
+    Tuplet tuplets[] = {
+        TupletInteger(PS_APP_TO_WATCH_COMMAND, (uint8_t)PS_APP_MESSAGE_COMMAND_SET_TIME),
+        TupletInteger(PS_APP_TO_WATCH_COMMAND_ID, (uint8_t)PHONE_COMMAND_ID),
+        TupletInteger(PS_APP_TO_WATCH_START_TIME_HOUR, (uint8_t)6),
+        TupletInteger(PS_APP_TO_WATCH_START_TIME_MINUTE, (uint8_t)30),
+        TupletInteger(PS_APP_TO_WATCH_END_TIME_HOUR, (uint8_t)7),
+        TupletInteger(PS_APP_TO_WATCH_END_TIME_MINUTE, (uint8_t)0),
+    };
+    phone.command_ms = sim_now_ms();
+    sim_phone_send(tuplets, 6);
+}
+
+static void phone_watchdog(void *data) {
+    if (phone.done)
+        return;
+    if (sim_now_ms() - phone.last_rx_ms >= PHONE_RESUME_MS) {
+        phone.restarts++;
+        phone.last_rx_ms = sim_now_ms();
+        phone_request_sync();
+    }
+    sim_schedule(PHONE_CHECK_MS, phone_watchdog, NULL);
+}
+
+// ================== Watch side ======================
+static void fill_night_values() {
+    // Long quiet stretches with movement bursts, roughly a real night
+    sim_seed(7);
+    int level = 0;
+    for (int i = 0; i < NIGHT_VALUES; i++) {
+        int pos = i % 90;
+        if (pos < 8) {
+            level = 40 + sim_random() % 180;
+        } else if (pos < 30) {
+            level = level > 10 ? level - 10 : 0;
+        } else {
+            level = 0;
+        }
+        night_values[i] = level;
+    }
+}
+
+static void store_nights() {
+    for (int i = 0; i < NIGHTS; i++) {
+        StatData sd;
+        sd.start_time = SIM_EPOCH - (NIGHTS - i) * 24 * 3600;
+        sd.end_time = sd.start_time + 8 * 3600;
+        for (int p = 0; p < COUNT_PHASES; p++)
+            sd.stat[p] = 60 + 10 * p + i;
+        persist_write_data(STAT_START + i, &sd, sizeof(sd));
+    }
+    persist_write_int(COUNT_STATS_KEY, NIGHTS);
+    persist_write_int(NIGHT_SEQ_KEY, NIGHTS);
+    persist_write_int(VERSION_KEY, 8);
+
+    persist_write_int(PERSISTENT_COUNT_KEY, NIGHT_VALUES);
+    for (int i = 0; i * MAX_PERSIST_BUFFER < NIGHT_VALUES; i++) {
+        int size = MIN(MAX_PERSIST_BUFFER, NIGHT_VALUES - i * MAX_PERSIST_BUFFER);
+        persist_write_data(PERSISTENT_VALUES_KEY + i, &night_values[i * MAX_PERSIST_BUFFER], size);
+    }
+}
+
+static void app_init() {
+    // As handle_init() in main.c
+    int inbox_size = app_message_inbox_size_maximum();
+    int outbox_size = app_message_outbox_size_maximum();
+    app_message_open(inbox_size, outbox_size);
+    set_outbox_size(outbox_size);
+
+    app_message_register_inbox_received(in_received_handler);
+    app_message_register_inbox_dropped(in_dropped_handler);
+    app_message_register_outbox_sent(out_sent_handler);
+    app_message_register_outbox_failed(out_failed_handler);
+}
+
+// ================== Scenarios ======================
+static void run_scenario(const LinkProfile *profile, Protocol protocol, bool queued) {
+    sim_reset(SIM_EPOCH);
+    SimLink link;
+    sim_link_default(&link);
+    link.latency_ms = profile->latency_ms;
+    link.bytes_per_sec = profile->bytes_per_sec;
+    link.drop_per_mille = profile->drop_per_mille;
+    link.busy_per_mille = profile->busy_per_mille;
+    sim_link_set(&link);
+
+    store_nights();
+    app_init();
+    EnergyCounts start;
+    energy_collect(&start, NULL);
+
+    memset(&phone, 0, sizeof(phone));
+    phone.protocol = protocol;
+    phone.queued = queued;
+    phone.hwm = PHONE_HWM;
+    sim_phone_set_receiver(phone_receive);
+    sim_seed(1 + protocol * 31 + (profile - profiles));
+
+    phone.started_ms = sim_now_ms();
+    phone_request_sync();
+    sim_schedule(PHONE_CHECK_MS, phone_watchdog, NULL);
+    sim_schedule(PHONE_COMMAND_MS, phone_send_command, NULL);
+
+    while (!phone.done && sim_now_ms() < SYNC_DEADLINE_MS && sim_step()) {
+    }
+    // Let the watch close the sync
+    sim_run_until(sim_now_ms() + 5000);
+
+    const SimLinkCounters *c = sim_link_counters();
+    const SyncSummary *s = sync_metrics_last();
+    EnergyCosts costs;
+    EnergyCounts counts;
+    energy_default_costs(&costs);
+    energy_collect(&counts, &start);
+    char time_text[16];
+    char ack_text[16];
+    if (phone.ack_ms)
+        snprintf(ack_text, sizeof(ack_text), "%lu", (unsigned long)(phone.ack_ms - phone.command_ms));
+    else
+        snprintf(ack_text, sizeof(ack_text), "-");
+    if (phone.done)
+        snprintf(time_text, sizeof(time_text), "%.1f", (phone.done_ms - phone.started_ms) / 1000.0);
+    else
+        snprintf(time_text, sizeof(time_text), "-");
+    char protocol_text[16];
+    snprintf(protocol_text, sizeof(protocol_text), "%s%s", protocol_names[protocol], queued ? "+q" : "");
+    // Queued behind a sync request, the command still runs during the sync
+    bool ok = phone.done && phone.verified && phone.ack_ms && (!queued || phone.ack_ms < phone.done_ms);
+    printf("%-6s %-10s %8s %6lu %6lu %7lu %5lu %5lu %6lu %8lu %5d %6u %6s %6.1f  %s\n",
+           profile->name, protocol_text, time_text,
+           (unsigned long)c->watch_msgs, (unsigned long)c->phone_msgs, (unsigned long)c->watch_bytes,
+           (unsigned long)c->busy, (unsigned long)c->dropped, (unsigned long)c->outbox_busy,
+           (unsigned long)s->bytes_per_sec, phone.restarts, s->chunk_bytes, ack_text,
+           energy_uah(&counts, &costs),
+           ok ? "ok" : "FAILED");
+    fflush(stdout);
+    exit(ok ? 0 : 1);
+}
+
+static int run_forked(const LinkProfile *profile, Protocol protocol, bool queued) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_scenario(profile, protocol, queued);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *only = argc > 1 ? argv[1] : NULL;
+    int failed = 0;
+
+    fill_night_values();
+    printf("%d nights, %d values in the last one, phone has nights up to %d\n",
+           NIGHTS, NIGHT_VALUES, PHONE_HWM);
+    printf("%-6s %-10s %8s %6s %6s %7s %5s %5s %6s %8s %5s %6s %6s %6s\n",
+           "link", "protocol", "time[s]", "w->p", "p->w", "bytes", "busy", "lost",
+           "obusy", "B/s", "rsync", "chunk", "ack[ms]", "uAh");
+
+    for (unsigned i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        if (only && strcmp(only, profiles[i].name) != 0)
+            continue;
+        for (int p = PROTOCOL_LEGACY; p <= PROTOCOL_DELTA_RLE; p++) {
+            if (!run_forked(&profiles[i], p, false))
+                failed++;
+        }
+    }
+    // Settings queued behind a second START_SYNC
+    if (!only || strcmp(only, profiles[0].name) == 0) {
+        if (!run_forked(&profiles[0], PROTOCOL_RAW, true))
+            failed++;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,372 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Generates accelerometer traces (accel_trace.h) of synthetic nights for
+// night_replay. A sleep cycle model decides the stage of every sample, a
+// noise model turns the stage into movement: sensor noise all the time,
+// bursts of movement more likely and stronger the lighter the sleep, and
+// turns that change the resting orientation. On top of that come the
+// edge cases - vibrations, sensor dropouts, a DST change and wake windows
+// anywhere in the day, midnight included.
+//
+//   trace_gen [options] out.bin
+//
+// With -n more than 1 the nights go to out_0000.bin, out_0001.bin, ...
+// Nights are numbered from the seed, so night i of a run is the same
+// whatever -n is.
+
+#include <getopt.h>
+#include <math.h>
+#include <pebble.h>
+#include "constants.h"
+#include "accel_trace.h"
+
+// 2015-01-05, the first night starts on it, the next ones a day later
+#define FIRST_DAY 1420416000
+#define DAY_SECONDS (24 * 3600)
+#define GRAVITY 1000
+
+typedef enum {
+    STAGE_AWAKE,
+    STAGE_LIGHT,
+    STAGE_REM,
+    STAGE_DEEP,
+    STAGES
+} Stage;
+
+static const char stage_letters[STAGES] = { 'A', 'L', 'R', 'D' };
+
+// Chance of a movement burst starting, per mille of the samples
+static const int burst_per_mille[STAGES] = { 50, 6, 3, 1 };
+// Peak amplitude of a burst, mg
+static const int burst_amplitude[STAGES] = { 700, 400, 120, 250 };
+
+typedef struct {
+    int hours_x10;              // length of the night in tenths of hours
+    int bed_minute;             // local minute of the day the night starts
+    int utc_offset_min;
+    int dst_after_min;          // minutes into the night the offset changes, -1 never
+    int dst_shift_min;
+    int restless;               // 0-100
+    int noise;                  // sensor noise, mg
+    int vibrations;             // per night
+    int dropout_per_mille;      // per minute
+    int window_start;           // local minutes of the day
+    int window_end;
+    int mode;
+    bool verbose;
+} GenOptions;
+
+typedef struct {
+    uint32_t state;
+} Random;
+
+static uint32_t next_random(Random *rnd) {
+    // xorshift32, the same on every host
+    rnd->state ^= rnd->state << 13;
+    rnd->state ^= rnd->state >> 17;
+    rnd->state ^= rnd->state << 5;
+    return rnd->state;
+}
+
+// Uniform in [lo, hi]
+static int uniform(Random *rnd, int lo, int hi) {
+    return lo + (int)(next_random(rnd) % (uint32_t)(hi - lo + 1));
+}
+
+static bool chance_per_mille(Random *rnd, int per_mille) {
+    return (int)(next_random(rnd) % 1000) < per_mille;
+}
+
+/*
+ * Sleep cycle model - minutes of every stage. Falls asleep through light
+ * sleep, then cycles of about 90 minutes: light, deep, light, REM, with
+ * less deep and more REM towards the morning. A cycle can end in a short
+ * awakening, more often in a restless night.
+ */
+static int plan_stages(Random *rnd, const GenOptions *opt, uint8_t *stages, int minutes) {
+    int m = 0;
+    int latency = uniform(rnd, 5, 15 + opt->restless / 4);
+    for (int i = 0; i < latency && m < minutes; i++)
+        stages[m++] = i < latency / 2 ? STAGE_AWAKE : STAGE_LIGHT;
+
+    for (int cycle = 0; m < minutes; cycle++) {
+        int length = uniform(rnd, 75, 105);
+        int deep = length * (MAX(5, 40 - cycle * 10)) / 100;
+        int rem = length * (MIN(35, 10 + cycle * 6)) / 100;
+        int light = length - deep - rem;
+        int parts[][2] = {
+            { STAGE_LIGHT, light / 2 },
+            { STAGE_DEEP, deep },
+            { STAGE_LIGHT, light - light / 2 },
+            { STAGE_REM, rem },
+        };
+        for (int p = 0; p < 4; p++) {
+            for (int i = 0; i < parts[p][1] && m < minutes; i++)
+                stages[m++] = parts[p][0];
+        }
+        if (chance_per_mille(rnd, 150 + opt->restless * 5)) {
+            int awake = uniform(rnd, 1, 3 + opt->restless / 10);
+            for (int i = 0; i < awake && m < minutes; i++)
+                stages[m++] = STAGE_AWAKE;
+        }
+    }
+    return m;
+}
+
+/*
+ * Noise model state of one night
+ */
+typedef struct {
+    int base_x, base_y, base_z;     // gravity in the resting position
+    int burst_left;
+    int burst_amplitude;
+    int dropout_left;
+    int8_t dropout_status;
+    int vibrate_left;
+} Motion;
+
+static void turn(Random *rnd, Motion *motion) {
+    // Back, side or front with some tilt, always about 1 g
+    static const int positions[][3] = {
+        { 0, 0, -GRAVITY }, { GRAVITY, 0, 0 }, { -GRAVITY, 0, 0 }, { 0, 0, GRAVITY },
+    };
+    const int *p = positions[uniform(rnd, 0, 3)];
+    motion->base_x = p[0] + uniform(rnd, -250, 250);
+    motion->base_y = p[1] + uniform(rnd, -250, 250);
+    motion->base_z = p[2] + uniform(rnd, -250, 250);
+}
+
+static int noise(Random *rnd, int spread) {
+    // Triangular, close enough to the sensor
+    return (uniform(rnd, -spread, spread) + uniform(rnd, -spread, spread)) / 2;
+}
+
+static int16_t clamp_mg(int value) {
+    return MAX(-4000, MIN(4000, value));
+}
+
+static void make_sample(Random *rnd, const GenOptions *opt, Stage stage, Motion *motion, AccelTraceSample *sample) {
+    int restless_factor = 50 + opt->restless;       // percent
+    if (motion->burst_left == 0
+            && chance_per_mille(rnd, burst_per_mille[stage] * restless_factor / 100 + (burst_per_mille[stage] > 0))) {
+        motion->burst_left = uniform(rnd, 2, 30);
+        motion->burst_amplitude = burst_amplitude[stage] * uniform(rnd, 30, 100) / 100;
+        if (stage != STAGE_REM && chance_per_mille(rnd, 300))
+            turn(rnd, motion);
+    }
+
+    int spread = opt->noise;
+    if (motion->burst_left > 0) {
+        spread += motion->burst_amplitude;
+        motion->burst_left--;
+    }
+    sample->x = clamp_mg(motion->base_x + noise(rnd, spread));
+    sample->y = clamp_mg(motion->base_y + noise(rnd, spread));
+    sample->z = clamp_mg(motion->base_z + noise(rnd, spread));
+    sample->status = 0;
+    sample->did_vibrate = 0;
+
+    if (motion->vibrate_left > 0) {
+        // The motor shakes the watch, the sensor flags it
+        sample->x = clamp_mg(sample->x + noise(rnd, 1500));
+        sample->did_vibrate = 1;
+        motion->vibrate_left--;
+    }
+    if (motion->dropout_left > 0) {
+        sample->status = motion->dropout_status;
+        motion->dropout_left--;
+    }
+}
+
+static bool generate_night(const GenOptions *opt, uint32_t seed, int night, const char *path) {
+    // Every night has its own generator, so it depends on the seed and the index only
+    Random rnd = { .state = (seed + 1) * 2654435761u ^ (uint32_t)(night + 1) * 40503u };
+    if (rnd.state == 0)
+        rnd.state = 1;
+
+    AccelTraceHeader header;
+    uint32_t local_start = FIRST_DAY + night * DAY_SECONDS + opt->bed_minute * 60;
+    accel_trace_default(&header, local_start - opt->utc_offset_min * 60);
+    header.utc_offset = opt->utc_offset_min * 60;
+    if (opt->dst_after_min >= 0) {
+        header.dst_time = header.start_time + opt->dst_after_min * 60;
+        header.dst_offset = (opt->utc_offset_min + opt->dst_shift_min) * 60;
+    }
+    header.mode = opt->mode;
+    header.start_wake_hour = opt->window_start / 60;
+    header.start_wake_min = opt->window_start % 60;
+    header.end_wake_hour = opt->window_end / 60;
+    header.end_wake_min = opt->window_end % 60;
+
+    int minutes = opt->hours_x10 * 6;
+    uint8_t *stages = malloc(minutes);
+    plan_stages(&rnd, opt, stages, minutes);
+
+    // Vibrations - notifications coming in during the night
+    int *vibrate_at = malloc(sizeof(int) * (opt->vibrations + 1));
+    for (int i = 0; i < opt->vibrations; i++)
+        vibrate_at[i] = uniform(&rnd, 0, minutes * 60 - 1);
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "%s: cannot create\n", path);
+        free(stages);
+        free(vibrate_at);
+        return false;
+    }
+    bool ok = accel_trace_write_header(out, &header);
+
+    Motion motion;
+    memset(&motion, 0, sizeof(motion));
+    turn(&rnd, &motion);
+    uint32_t samples = (uint64_t)minutes * 60 * 1000 / header.sample_ms;
+    int last_minute = -1;
+    for (uint32_t i = 0; i < samples && ok; i++) {
+        uint32_t at_ms = i * header.sample_ms;
+        int minute = at_ms / 60000;
+        if (minute != last_minute) {
+            last_minute = minute;
+            if (motion.dropout_left == 0 && chance_per_mille(&rnd, opt->dropout_per_mille)) {
+                motion.dropout_left = uniform(&rnd, 1, 50);
+                motion.dropout_status = chance_per_mille(&rnd, 500) ? -1 : -2;
+            }
+        }
+        for (int v = 0; v < opt->vibrations; v++) {
+            if (vibrate_at[v] == (int)(at_ms / 1000) && at_ms % 1000 < header.sample_ms)
+                motion.vibrate_left = uniform(&rnd, 2, 6);
+        }
+        AccelTraceSample sample;
+        make_sample(&rnd, opt, stages[minute], &motion, &sample);
+        ok = accel_trace_write_sample(out, &sample);
+    }
+    ok = ok && accel_trace_finish(out, samples);
+    ok = fclose(out) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "%s: write failed\n", path);
+
+    if (opt->verbose) {
+        // The stages as runs, to compare with the phases night_replay finds
+        printf("%s stages", path);
+        for (int m = 0; m < minutes; ) {
+            int run = 1;
+            while (m + run < minutes && stages[m + run] == stages[m])
+                run++;
+            printf(" %c%d", stage_letters[stages[m]], run);
+            m += run;
+        }
+        printf("\n");
+    }
+    free(stages);
+    free(vibrate_at);
+    return ok;
+}
+
+static bool parse_clock(const char *text, int *minute) {
+    int h, m;
+    if (sscanf(text, "%d:%d", &h, &m) != 2 || !IN_RANGE(h, 0, 23) || !IN_RANGE(m, 0, 59))
+        return false;
+    *minute = h * 60 + m;
+    return true;
+}
+
+static bool parse_window(const char *text, GenOptions *opt) {
+    const char *dash = strchr(text, '-');
+    return dash && parse_clock(text, &opt->window_start) && parse_clock(dash + 1, &opt->window_end);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "usage: %s [options] out.bin\n"
+        "  -n nights      number of nights, out_0000.bin ... when more than 1\n"
+        "  -s seed\n"
+        "  -H hours       length of the night, 8 by default, 12 and more pass MAX_COUNT\n"
+        "  -b HH:MM       local time the night starts, 23:00\n"
+        "  -w HH:MM-HH:MM wake window, 06:30-07:00, may cross midnight\n"
+        "  -W             weekend mode, no alarm\n"
+        "  -z minutes     UTC offset\n"
+        "  -d after:shift the UTC offset changes by shift minutes after minutes into the night\n"
+        "  -r 0-100       restlessness, 30\n"
+        "  -N mg          sensor noise, 8\n"
+        "  -v count       vibrations during the night\n"
+        "  -x per mille   sensor dropouts per minute, peek fails with -1 or -2\n"
+        "  -p             print the planned stages\n", name);
+}
+
+int main(int argc, char **argv) {
+    GenOptions opt = {
+        .hours_x10 = 80,
+        .bed_minute = 23 * 60,
+        .dst_after_min = -1,
+        .restless = 30,
+        .noise = 8,
+        .window_start = 6 * 60 + 30,
+        .window_end = 7 * 60,
+        .mode = MODE_WORKDAY,
+    };
+    int nights = 1;
+    uint32_t seed = 1;
+    int c;
+    while ((c = getopt(argc, argv, "n:s:H:b:w:Wz:d:r:N:v:x:p")) != -1) {
+        bool ok = true;
+        switch (c) {
+            case 'n': nights = atoi(optarg); ok = nights > 0; break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            case 'H': opt.hours_x10 = (int)round(atof(optarg) * 10); ok = IN_RANGE(opt.hours_x10, 1, 480); break;
+            case 'b': ok = parse_clock(optarg, &opt.bed_minute); break;
+            case 'w': ok = parse_window(optarg, &opt); break;
+            case 'W': opt.mode = MODE_WEEKEND; break;
+            case 'z': opt.utc_offset_min = atoi(optarg); break;
+            case 'd': ok = sscanf(optarg, "%d:%d", &opt.dst_after_min, &opt.dst_shift_min) == 2 && opt.dst_after_min >= 0; break;
+            case 'r': opt.restless = atoi(optarg); ok = IN_RANGE(opt.restless, 0, 100); break;
+            case 'N': opt.noise = atoi(optarg); ok = opt.noise >= 0; break;
+            case 'v': opt.vibrations = atoi(optarg); ok = opt.vibrations >= 0; break;
+            case 'x': opt.dropout_per_mille = atoi(optarg); ok = IN_RANGE(opt.dropout_per_mille, 0, 1000); break;
+            case 'p': opt.verbose = true; break;
+            default: ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *out = argv[optind];
+    const char *ext = strrchr(out, '.');
+    int stem = ext ? (int)(ext - out) : (int)strlen(out);
+    char path[1024];
+    for (int i = 0; i < nights; i++) {
+        if (nights == 1)
+            snprintf(path, sizeof(path), "%s", out);
+        else
+            snprintf(path, sizeof(path), "%.*s_%04d%s", stem, out, i, ext ? ext : "");
+        if (!generate_night(&opt, seed, i, path))
+            return 1;
+    }
+    return 0;
+}
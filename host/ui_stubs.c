@@ -0,0 +1,56 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// The windows of the watch app are not part of the host build
+
+#include <pebble.h>
+#include "syncprogress_window.h"
+#include "sleep_window.h"
+#include "live_window.h"
+
+void show_syncprogress_window(void) {
+}
+
+void hide_syncprogress_window(void) {
+}
+
+void show_sleep_window(void) {
+}
+
+void hide_sleep_window(void) {
+}
+
+void refresh_display(void) {
+}
+
+void toggle_sleep(void) {
+}
+
+void show_live_window(void) {
+}
+
+void hide_live_window(void) {
+}
+
+void refresh_live_window(void) {
+}
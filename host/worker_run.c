@@ -0,0 +1,125 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Runs the worker for a night on the virtual clock: random light and
+// restless spells over a quiet baseline, alarm window 06:30-07:00. The
+// app side only ends the night when the worker asks for the alarm.
+//
+//   worker_run [hours] [seed]
+
+#include <pebble.h>
+#include "sim.h"
+#include "constants.h"
+
+// 2015-01-01 23:00 UTC
+#define SIM_EPOCH 1420153200
+#define DEFAULT_HOURS 8
+#define APP_OPEN_MS (5 * 60 * 1000)
+
+int pebslee_worker_main(void);
+
+static uint64_t alarm_ms = 0;
+static uint32_t minute_msgs = 0;
+static uint32_t restless_until_s = 0;
+
+static int accel_source(uint64_t now_ms, AccelData *sample) {
+    uint32_t now_s = now_ms / 1000;
+    // A restless spell of up to 3 minutes every 40 minutes or so
+    if (now_s >= restless_until_s && sim_random() % (40 * 200) == 0)
+        restless_until_s = now_s + 30 + sim_random() % 150;
+    int spread = now_s < restless_until_s ? 600 : 12;
+    sample->x = (int)(sim_random() % (2 * spread + 1)) - spread;
+    sample->y = (int)(sim_random() % (2 * spread + 1)) - spread;
+    sample->z = -1000 + (int)(sim_random() % (2 * spread + 1)) - spread;
+    return 0;
+}
+
+static void close_app(void *data) {
+    AppWorkerMessage closed = { 0 };
+    sim_worker_deliver(APP_CMD_APP_CLOSED, &closed);
+}
+
+static void app_receiver(uint8_t type, const AppWorkerMessage *data) {
+    if (type == WORKER_CMD_EXEC_ALARM && alarm_ms == 0) {
+        // The app would ring and kill the worker
+        alarm_ms = sim_now_ms();
+        sim_set_event_loop_end(alarm_ms);
+    } else if (type == WORKER_CMD_MINUTE_VALUE) {
+        minute_msgs++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int hours = argc > 1 ? atoi(argv[1]) : DEFAULT_HOURS;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+    sim_reset(SIM_EPOCH);
+    sim_seed(seed);
+    sim_accel_set_source(accel_source);
+    sim_worker_set_receiver(app_receiver);
+
+    GlobalConfig config = {
+        .mode = MODE_WORKDAY,
+        .status = STATUS_ACTIVE,
+        .start_wake_hour = 6,
+        .start_wake_min = 30,
+        .end_wake_hour = 7,
+        .end_wake_min = 0,
+        .up_coef = UP_COEF_NORMAL,
+        .down_coef = DOWN_COEF_NORMAL,
+        .active_profile = ACTIVE_PROFILE_NORMAL,
+    };
+    persist_write_data(CONFIG_PERSISTENT_KEY, &config, sizeof(config));
+
+    // The app is open for the first minutes, like after starting the tracking
+    AppWorkerMessage open = { 0 };
+    sim_worker_deliver(APP_CMD_APP_OPEN, &open);
+    sim_schedule(APP_OPEN_MS, close_app, NULL);
+
+    sim_set_event_loop_end((uint64_t)hours * 3600 * 1000);
+    clock_t started = clock();
+    pebslee_worker_main();
+    double took_ms = (clock() - started) * 1000.0 / CLOCKS_PER_SEC;
+
+    StatData stat;
+    int stats = persist_read_int(COUNT_STATS_KEY);
+    if (stats <= 0 || persist_read_data(STAT_START + stats - 1, &stat, sizeof(stat)) != sizeof(stat)) {
+        printf("no night stored\n");
+        return 1;
+    }
+    WorkerCounters counters;
+    persist_read_data(WORKER_COUNTERS_KEY, &counters, sizeof(counters));
+    const SimDeviceCounters *device = sim_device_counters();
+
+    printf("night of %d minutes in %.1f ms\n", persist_read_int(PERSISTENT_COUNT_KEY), took_ms);
+    printf("deep %d rem %d light %d awake %d\n", stat.stat[0], stat.stat[1], stat.stat[2], stat.stat[3]);
+    if (alarm_ms)
+        printf("alarm at minute %d\n", (int)(alarm_ms / 60000));
+    else
+        printf("no alarm\n");
+    printf("%u samples, %u minute ticks, %u flash writes, %u worker messages (%u minute values)\n",
+           counters.motion_runs, counters.minute_ticks, counters.persist_writes,
+           device->worker_msgs, minute_msgs);
+    return 0;
+}
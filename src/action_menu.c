@@ -13,6 +13,7 @@
 #include "persistence.h"
 #include "logic.h"
 #include "localize.h"
+#include "diagnostics.h"
 
 
 // BEGIN AUTO-GENERATED UI CODE; DO NOT MODIFY
@@ -122,6 +123,13 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
     }
 }
 
+// Long select on the version row opens the diagnostics page
+static void menu_select_long_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
+    if (cell_index->row == 7) {
+        show_diagnostics_window();
+    }
+}
+
 // Here we capture when a user selects a menu item
 void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
     float coefd = get_config()->down_coef;
@@ -228,6 +236,7 @@ static void initialise_ui(void) {
 //        .draw_header = menu_draw_header_callback,
         .draw_row = menu_draw_row_callback,
         .select_click = menu_select_callback,
+        .select_long_click = menu_select_long_callback,
     });
 
     menu_layer_set_click_config_onto_window(s_menulayer, s_window);
@@ -242,6 +251,7 @@ static void destroy_ui(void) {
 
 static void handle_window_unload(Window* window) {
     destroy_ui();
+    diag_sample(DIAG_MENU_WINDOW);
 }
 
 void show_action_menu(void) {
@@ -250,6 +260,7 @@ void show_action_menu(void) {
         .unload = handle_window_unload,
     });
     window_stack_push(s_window, true);
+    diag_sample(DIAG_MENU_WINDOW);
 }
 
 void hide_action_menu(void) {
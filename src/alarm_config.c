@@ -24,6 +24,8 @@
 #include "alarm_config.h"
 #include "logic.h"
 #include "localize.h"
+#include "resource_cache.h"
+#include "diagnostics.h"
 
 #define NONE_SELECTED 0
 #define START_HOUR_SELECTED 1
@@ -71,8 +73,8 @@ static void initialise_ui(void) {
 #endif
 
     s_res_bitham_30_black = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
-    s_res_img_up_arrow_black_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_UP_ARROW_BLACK_8X14);
-    s_res_img_down_arrow_black_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_DOWN_ARROW_BLACK_8X14);
+    s_res_img_up_arrow_black_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_UP_ARROW_BLACK_8X14);
+    s_res_img_down_arrow_black_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_DOWN_ARROW_BLACK_8X14);
     // s_start_hour
     s_start_hour = text_layer_create(GRect(21+wd, 27+hd, 44, 38));
     text_layer_set_text(s_start_hour, "00");
@@ -171,13 +173,14 @@ static void destroy_ui(void) {
     bitmap_layer_destroy(s_bm_end_m_down);
     bitmap_layer_destroy(s_bm_end_h_up);
     bitmap_layer_destroy(s_bm_end_m_up);
-    gbitmap_destroy(s_res_img_up_arrow_black_8x14);
-    gbitmap_destroy(s_res_img_down_arrow_black_8x14);
+    resource_cache_release_bitmap(s_res_img_up_arrow_black_8x14);
+    resource_cache_release_bitmap(s_res_img_down_arrow_black_8x14);
 }
 // END AUTO-GENERATED UI CODE
 
 static void handle_window_unload(Window* window) {
     destroy_ui();
+    diag_sample(DIAG_ALARM_WINDOW);
 }
 
 static void set_layer_white_text(TextLayer *a_text_layer) {
@@ -403,6 +406,7 @@ void show_alarm_config(void) {
     window_set_click_config_provider(s_window, config_provider);
     update_ui();
     window_stack_push(s_window, true);
+    diag_sample(DIAG_ALARM_WINDOW);
 }
 
 void hide_alarm_config(void) {
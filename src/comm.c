@@ -29,6 +29,11 @@
 #include "syncprogress_window.h"
 #include "localize.h"
 #include "sleep_window.h"
+#include "sync_codec.h"
+#include "sync_metrics.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "write_account.h"
 
 // ================== Communication ======================
 static AppTimer *timerSync;
@@ -36,14 +41,49 @@ static AppTimer *timerSend;
 
 static bool sync_start = false;
 static bool sync_in_progress = false;
+// A live batch or the command replies own the outbox - the sync waits for them
+static bool live_in_flight = false;
+static bool reply_in_flight = false;
 
 const int SYNC_STEP_MS = 3000;
 const int SEND_STEP_MS = 100;
 const int MAX_SEND_VALS = 40;
+const int MAX_SEND_RETRIES = 10;
+
+// AIMD control of the message size - grow while the acks come fast,
+// halve when the phone is busy or does not answer
+const int CHUNK_MIN_BYTES = 64;
+const int CHUNK_STEP_BYTES = 64;
+const int CHUNK_FAST_ACK_MS = 300;
 
 static uint32_t message_outbox_size = 0;
 
+static uint16_t chunk_bytes = 0;
+static uint16_t stored_chunk_bytes = 0;
+static uint16_t in_flight_bytes = 0;
+static uint32_t send_started_ms = 0;
+
 static SendData sendData;
+// Encoding asked for by the phone with the last START_SYNC
+static int requested_encoding = PS_SYNC_ENCODING_RAW;
+// Set when the phone told which nights it already has
+static bool incremental_sync = false;
+static uint32_t requested_hwm = 0;
+static int requested_offset = 0;
+// History export instead of sync
+static bool export_requested = false;
+static StatData *export_stats = NULL;
+static int export_count = 0;
+
+static void command_queue_drain();
+static bool send_replies();
+
+static void outbox_send(DictionaryIterator *iter, int count) {
+    sendData.in_flight = count;
+    in_flight_bytes = dict_write_end(iter);
+    send_started_ms = timestamp_ms();
+    app_message_outbox_send();
+}
 
 static void send_header_data() {
     DictionaryIterator *iter;
@@ -56,29 +96,300 @@ static void send_header_data() {
     Tuplet value_count = TupletInteger(PS_APP_MSG_HEADER_COUNT, sendData.count_values);
     dict_write_tuplet(iter, &value_count);
 
-    dict_write_end(iter);
-    app_message_outbox_send();
+    // Old phones know only the keys above, so keep the header as it was for them
+    if (sendData.encoding != PS_SYNC_ENCODING_RAW) {
+        Tuplet value_encoding = TupletInteger(PS_APP_MSG_HEADER_ENCODING, sendData.encoding);
+        dict_write_tuplet(iter, &value_encoding);
+        Tuplet value_size = TupletInteger(PS_APP_MSG_HEADER_ENCODED_SIZE, sendData.encoded_size);
+        dict_write_tuplet(iter, &value_size);
+        Tuplet value_ms = TupletInteger(PS_APP_MSG_HEADER_ENCODE_MS, sendData.encode_ms);
+        dict_write_tuplet(iter, &value_ms);
+    }
+    if (incremental_sync) {
+        Tuplet value_seq = TupletInteger(PS_APP_MSG_HEADER_SEQ, sendData.seq);
+        dict_write_tuplet(iter, &value_seq);
+        Tuplet value_stats = TupletBytes(PS_APP_MSG_HEADER_STATS, (uint8_t *)sendData.stat, sizeof(sendData.stat));
+        dict_write_tuplet(iter, &value_stats);
+        Tuplet value_offset = TupletInteger(PS_APP_MSG_HEADER_OFFSET, (uint16_t)sendData.offset);
+        dict_write_tuplet(iter, &value_offset);
+
+        // Only the last night has its counters kept
+        WorkerCounters counters;
+        if (sendData.seq == sendData.last_seq &&
+            persist_read_data(WORKER_COUNTERS_KEY, &counters, sizeof(WorkerCounters)) == sizeof(WorkerCounters)) {
+            Tuplet value_counters = TupletBytes(PS_APP_MSG_HEADER_WORKER_COUNTERS, (uint8_t *)&counters, sizeof(WorkerCounters));
+            dict_write_tuplet(iter, &value_counters);
+        }
+    }
+
+    outbox_send(iter, 0);
     return;
 }
 
+/*
+ * Tells the phone that all nights up to the sequence are sent,
+ * so it can use it as high-water mark for the next sync
+ */
+static void send_done_data() {
+    DictionaryIterator *iter;
+    app_message_outbox_begin(&iter);
+
+    Tuplet value_done = TupletInteger(PS_APP_MSG_SYNC_DONE, sendData.last_seq);
+    dict_write_tuplet(iter, &value_done);
+    Tuplet value_throughput = TupletInteger(PS_APP_MSG_SYNC_BYTES_PER_SEC, sync_metrics_current()->bytes_per_sec);
+    dict_write_tuplet(iter, &value_throughput);
+    Tuplet value_retries = TupletInteger(PS_APP_MSG_SYNC_RETRIES, sync_metrics_current()->retries);
+    dict_write_tuplet(iter, &value_retries);
+
+    outbox_send(iter, 0);
+}
+
+static void finish_sync(bool completed) {
+    sync_metrics_finish(completed, chunk_bytes);
+    trace(TRACE_SYNC_END, completed);
+    // Still holding the night
+    diag_sample(DIAG_SYNC);
+
+    // Remember the size for the next sync - only one that got through,
+    // and only if it changed to save flash writes
+    if (completed && chunk_bytes != stored_chunk_bytes) {
+        persist_write_int(CHUNK_SIZE_KEY, chunk_bytes);
+        stored_chunk_bytes = chunk_bytes;
+    }
+
+    sync_in_progress = false;
+    sync_start = false;
+    free(sendData.motionData);
+    sendData.motionData = NULL;
+    free(export_stats);
+    export_stats = NULL;
+    hide_syncprogress_window();
+
+    // Commands held back by the sync
+    command_queue_drain();
+    send_replies();
+}
+
+static void encode_motion_data() {
+    sendData.encoded_size = 0;
+    sendData.encode_ms = 0;
+    if (sendData.countTuplets <= 0 || sendData.motionData == NULL)
+        return;
+
+    int max_size = SYNC_CODEC_MAX_SIZE(sendData.countTuplets);
+    uint8_t *encoded = malloc(max_size);
+    if (encoded == NULL) {
+        D("Error allocating memory %d, fall back to raw", max_size);
+        sendData.encoding = PS_SYNC_ENCODING_RAW;
+        return;
+    }
+
+    uint32_t started = timestamp_ms();
+    int encoded_size = sync_encode_delta_rle(sendData.motionData, sendData.countTuplets, encoded, max_size);
+    sendData.encode_ms = timestamp_ms() - started;
+
+    if (encoded_size < 0) {
+        free(encoded);
+        sendData.encoding = PS_SYNC_ENCODING_RAW;
+        return;
+    }
+    D("Encoded %d values to %d bytes in %d ms", sendData.countTuplets, encoded_size, sendData.encode_ms);
+
+    // The raw values are not needed anymore
+    free(sendData.motionData);
+    sendData.motionData = encoded;
+    sendData.encoded_size = encoded_size;
+}
+
+/*
+ * How many values (raw) or bytes (encoded) fit in the current message size
+ */
+static int chunk_size() {
+    if (sendData.encoding != PS_SYNC_ENCODING_RAW) {
+        // The values go as byte arrays, so only the tuple headers are overhead
+        return chunk_bytes - dict_calc_buffer_size(2, sizeof(uint16_t), 0);
+    }
+    int value_bytes = dict_calc_buffer_size(1, sizeof(uint8_t)) - dict_calc_buffer_size(0);
+    return (chunk_bytes - dict_calc_buffer_size(0)) / value_bytes;
+}
+
+static void init_chunk_bytes() {
+    if (chunk_bytes == 0) {
+        if (persist_exists(CHUNK_SIZE_KEY)) {
+            chunk_bytes = persist_read_int(CHUNK_SIZE_KEY);
+        } else {
+            // What the fixed size used to be
+            chunk_bytes = dict_calc_buffer_size(MAX_SEND_VALS, sizeof(uint8_t));
+        }
+        stored_chunk_bytes = chunk_bytes;
+    }
+    chunk_bytes = MIN(MAX(chunk_bytes, CHUNK_MIN_BYTES), message_outbox_size);
+    D("Start with chunk of %d bytes for message outbox size %ld ", chunk_bytes, message_outbox_size);
+}
+
+/*
+ * Load header and values of the night with the sequence.
+ * Only the last night has its motion values kept on the watch.
+ */
+static void prepare_night(uint32_t seq, int offset) {
+    int csd = count_stat_data();
+
+    // Now read the stats for start and finish
+    StatData *lstat_data = read_stat_data_rec(csd - 1 - (sendData.last_seq - seq));
+    trace(TRACE_SYNC_NIGHT, seq);
+    // Header
+    sendData.seq = seq;
+    sendData.start_time = lstat_data->start_time;
+    sendData.end_time = lstat_data->end_time;
+    for (int i = 0; i < COUNT_PHASES; i++) {
+        sendData.stat[i] = lstat_data->stat[i];
+    }
+    free(lstat_data);
+
+    sendData.encoding = PS_SYNC_ENCODING_RAW;
+    sendData.encoded_size = 0;
+    sendData.encode_ms = 0;
+    sendData.motionData = NULL;
+    sendData.countTuplets = 0;
+    if (seq == sendData.last_seq) {
+        sendData.countTuplets = count_motion_values();
+        sendData.motionData = read_motion_data();
+        sendData.encoding = requested_encoding;
+        if (sendData.encoding == PS_SYNC_ENCODING_DELTA_RLE) {
+            encode_motion_data();
+        }
+    }
+    sendData.count_values = sendData.countTuplets;
+
+    int size = sendData.encoding != PS_SYNC_ENCODING_RAW ? sendData.encoded_size : sendData.countTuplets;
+    sendData.offset = MIN(MAX(offset, 0), size);
+
+    D("Night %ld: %d values from offset %d", seq, sendData.countTuplets, sendData.offset);
+
+    sendData.position = sendData.offset;
+    sendData.currentSendChunk = -1;
+}
+
+/*
+ * Current night is sent - continue with the next one or close the sync
+ */
+static void next_night() {
+    free(sendData.motionData);
+    sendData.motionData = NULL;
+
+    if (sendData.seq < sendData.last_seq) {
+        prepare_night(sendData.seq + 1, 0);
+        send_header_data();
+    } else if (incremental_sync && !sendData.done_sent) {
+        sendData.done_sent = true;
+        send_done_data();
+    } else {
+        finish_sync(true);
+    }
+}
+
+/*
+ * No (more) nights to send - only the done message goes
+ */
+static void send_nothing_left() {
+    sendData.seq = sendData.last_seq;
+    sendData.motionData = NULL;
+    sendData.done_sent = true;
+    sendData.currentSendChunk = 0;
+    sendData.offset = 0;
+    sendData.position = 0;
+    sendData.countTuplets = 0;
+    sendData.encoding = PS_SYNC_ENCODING_RAW;
+    send_done_data();
+}
+
+static void send_timer_callback();
+
+/*
+ * Export packs as many stat records as fit in one message, the phone
+ * numbers them from the sequence of the first one
+ */
+static void send_export_chunk() {
+    if (sendData.position >= export_count) {
+        free(export_stats);
+        export_stats = NULL;
+        if (export_count <= 0) {
+            send_nothing_left();
+            return;
+        }
+        // ...and then the curve of the last night as by the sync
+        prepare_night(sendData.last_seq, 0);
+        send_header_data();
+        return;
+    }
+
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+        D("App message busy.");
+        timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+        return;
+    }
+    int room = chunk_bytes - dict_calc_buffer_size(3, sizeof(uint32_t), sizeof(uint16_t), 0);
+    int count = MIN(MAX(room / (int)sizeof(StatData), 1), export_count - sendData.position);
+
+    uint32_t first_seq = sendData.last_seq - (export_count - 1 - sendData.position);
+    Tuplet value_seq = TupletInteger(PS_APP_MSG_EXPORT_FIRST_SEQ, first_seq);
+    dict_write_tuplet(iter, &value_seq);
+    Tuplet value_total = TupletInteger(PS_APP_MSG_EXPORT_TOTAL, (uint16_t)export_count);
+    dict_write_tuplet(iter, &value_total);
+    Tuplet value_records = TupletBytes(PS_APP_MSG_EXPORT_RECORDS, (uint8_t *)&export_stats[sendData.position], count * sizeof(StatData));
+    dict_write_tuplet(iter, &value_records);
+
+    outbox_send(iter, count);
+}
+
+static void send_encoded_chunk() {
+    uint16_t offset = sendData.position;
+    if (offset >= sendData.encoded_size) {
+        next_night();
+        return;
+    }
+    int size = MIN(chunk_size(), sendData.encoded_size - offset);
+
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+        D("App message busy.");
+        timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+        return;
+    }
+    Tuplet value_offset = TupletInteger(PS_APP_MSG_DATA_OFFSET, offset);
+    dict_write_tuplet(iter, &value_offset);
+    Tuplet value_bytes = TupletBytes(PS_APP_MSG_DATA_BYTES, &sendData.motionData[offset], size);
+    dict_write_tuplet(iter, &value_bytes);
+
+    outbox_send(iter, size);
+}
+
 static void send_timer_callback() {
+    // Commands that came in meanwhile run between the chunks
+    command_queue_drain();
+    if (send_replies())
+        return;
+
+    if (export_stats != NULL) {
+        send_export_chunk();
+        return;
+    }
     if (sendData.currentSendChunk == -1) {
         send_header_data();
         return;
     }
-    int tpIndex = (sendData.currentSendChunk * sendData.sendChunkSize);
+    if (sendData.encoding != PS_SYNC_ENCODING_RAW) {
+        send_encoded_chunk();
+        return;
+    }
+    int tpIndex = sendData.position;
     if (tpIndex >= sendData.countTuplets) {
-        // Finished with sync
-        sync_in_progress = false;
-        sync_start = false;
-        free(sendData.motionData);
-        hide_syncprogress_window();
+        // Finished with this night
+        next_night();
         return;
     }
 
-    int minIndex = tpIndex;
-    int maxIndex = MIN(tpIndex + sendData.sendChunkSize, sendData.countTuplets - 1);
-
     DictionaryIterator *iter;
     AppMessageResult resBegin = app_message_outbox_begin(&iter);
     if (iter == NULL) {
@@ -93,142 +404,533 @@ static void send_timer_callback() {
         D("App message busy.");
     }
 
-    for (int i = 0; i < sendData.sendChunkSize; i++, tpIndex++) {
-        if (tpIndex < sendData.countTuplets) {
-            Tuplet value = TupletInteger(tpIndex+3, sendData.motionData[tpIndex]);
-            DictionaryResult dw = dict_write_tuplet(iter, &value);
-            if (dw == DICT_OK) {
-            } else if (dw == DICT_NOT_ENOUGH_STORAGE) {
-                D("Dict not enught storage.");
-            } else if (dw == DICT_INVALID_ARGS) {
-                D("Dict invalid args.");
-            }
+    int count = MIN(chunk_size(), sendData.countTuplets - tpIndex);
+    int written = 0;
+    for (int i = 0; i < count; i++, tpIndex++) {
+        Tuplet value = TupletInteger(tpIndex+3, sendData.motionData[tpIndex]);
+        DictionaryResult dw = dict_write_tuplet(iter, &value);
+        if (dw == DICT_OK) {
+            written++;
+        } else if (dw == DICT_NOT_ENOUGH_STORAGE) {
+            D("Dict not enught storage.");
+            break;
+        } else if (dw == DICT_INVALID_ARGS) {
+            D("Dict invalid args.");
+            break;
         }
     }
-    int finBytes = dict_write_end(iter);
-    D("Finalizing msg with %d bytes", finBytes);
-
-    AppMessageResult resSend = app_message_outbox_send();
-    D("Result send: %d OK: %d", resSend, resSend == APP_MSG_OK);
+    // Only what made it into the message counts as sent
+    outbox_send(iter, written);
+    D("Finalizing msg with %d bytes", in_flight_bytes);
 }
 
 static void send_last_stored_data() {
-    // Generate tuplets
-    sendData.countTuplets = count_motion_values();
+    int csd = count_stat_data();
 
-    D("About to send %d records", sendData.countTuplets);
+    if (!incremental_sync) {
+        // Legacy phones get only the last night
+        prepare_night(sendData.last_seq, 0);
+        timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+        return;
+    }
 
-    int tpIndex = 0;
+    uint32_t first_seq = requested_hwm + 1;
+    int offset = requested_offset;
+    uint32_t oldest_seq = sendData.last_seq - csd + 1;
+    if (first_seq < oldest_seq) {
+        // The nights the phone misses are already gone
+        first_seq = oldest_seq;
+        offset = 0;
+    }
+    D("Incremental sync of nights %ld..%ld", first_seq, sendData.last_seq);
 
-    // Now read the stats for start and finish
-    StatData *lstat_data = read_last_stat_data();
-    // Header
-    sendData.start_time = lstat_data->start_time;
-    sendData.end_time = lstat_data->end_time;
-    sendData.count_values = sendData.countTuplets;
-    free(lstat_data);
-    sendData.motionData = read_motion_data();
+    if (csd <= 0 || first_seq > sendData.last_seq) {
+        // Nothing new - just confirm the high-water mark
+        timerSend = app_timer_register(SEND_STEP_MS, send_nothing_left, NULL);
+        return;
+    }
 
-    uint32_t size = dict_calc_buffer_size(sendData.countTuplets, sizeof(uint8_t));
+    prepare_night(first_seq, offset);
+    timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+}
 
-    if (size <= message_outbox_size) {
-        sendData.sendChunkSize = sendData.countTuplets;
-    } else {
-        sendData.sendChunkSize = (message_outbox_size / (size / sendData.countTuplets)) - 1; // -1 to be on the safe side
-    }
-    if (sendData.sendChunkSize > MAX_SEND_VALS || sendData.sendChunkSize <= 0) {
-        sendData.sendChunkSize = MAX_SEND_VALS;
+static void start_sync_transfer() {
+    sendData.last_seq = read_last_night_seq();
+    sendData.done_sent = false;
+    sendData.retries = 0;
+    sendData.motionData = NULL;
+
+    init_chunk_bytes();
+    sync_metrics_start();
+}
+
+/*
+ * The whole history in one transfer - all stat records packed,
+ * then the last night with its values
+ */
+static void send_history_export() {
+    export_stats = read_stat_data_block(&export_count);
+    D("Export %d stat records", export_count);
+    if (export_stats == NULL) {
+        export_count = 0;
+        timerSend = app_timer_register(SEND_STEP_MS, send_nothing_left, NULL);
+        return;
     }
-    D("Determined chunk size %d for message outbox size %ld ", sendData.sendChunkSize, message_outbox_size);
 
-    sendData.currentSendChunk = -1;
+    sendData.encoding = PS_SYNC_ENCODING_RAW;
+    sendData.currentSendChunk = 0;
+    sendData.position = 0;
     timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
 }
 
 static void sync_timer_callback() {
     if (sync_in_progress)
         return;
+    if (live_in_flight || reply_in_flight) {
+        // Wait for the outbox
+        timerSync = app_timer_register(SEND_STEP_MS, sync_timer_callback, NULL);
+        return;
+    }
     if (sync_start) {
-        sync_start = true;
+        sync_in_progress = true;
         show_syncprogress_window();
-        send_last_stored_data();
+        start_sync_transfer();
+        trace(TRACE_SYNC_START, export_requested ? PS_APP_MESSAGE_COMMAND_EXPORT_HISTORY : PS_APP_MESSAGE_COMMAND_START_SYNC);
+        if (export_requested) {
+            send_history_export();
+        } else {
+            send_last_stored_data();
+        }
+        diag_sample(DIAG_SYNC);
         return;
     }
 }
 
-void out_sent_handler(DictionaryIterator *sent, void *context) {
-    D("out_sent_handler:");
-    sendData.currentSendChunk += 1;
-    timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+// ================== Live streaming ======================
+// The worker hands over every finished minute while the app is open.
+// The values are batched, so the radio wakes up once per batch.
+const int LIVE_BATCH_MINUTES = 10;
+#define LIVE_MAX_VALUES 60
+
+static bool live_enabled = false;
+static uint8_t live_values[LIVE_MAX_VALUES];
+static uint16_t live_count = 0;
+static uint16_t live_first_minute = 0;
+static uint16_t live_sent_count = 0;
+static uint32_t live_last_time = 0;
+
+static int live_capacity() {
+    int room = message_outbox_size - dict_calc_buffer_size(3, sizeof(uint16_t), sizeof(uint32_t), 0);
+    return MIN(room, LIVE_MAX_VALUES);
 }
 
+static void live_flush() {
+    if (live_count == 0 || live_in_flight || reply_in_flight)
+        return;
+    // The outbox belongs to the sync, the values wait for the next batch
+    if (sync_start || sync_in_progress)
+        return;
+    if (!connection_service_peek_pebble_app_connection())
+        return;
 
-void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
-    D("out_failed_handler:");
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK)
+        return;
+    Tuplet value_minute = TupletInteger(PS_APP_MSG_LIVE_FIRST_MINUTE, live_first_minute);
+    dict_write_tuplet(iter, &value_minute);
+    Tuplet value_time = TupletInteger(PS_APP_MSG_LIVE_TIME, live_last_time);
+    dict_write_tuplet(iter, &value_time);
+    Tuplet value_values = TupletBytes(PS_APP_MSG_LIVE_VALUES, live_values, live_count);
+    dict_write_tuplet(iter, &value_values);
+    dict_write_end(iter);
 
-    // Repeat lst chunk - do not increment the currentSendChunk
-    timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+    if (app_message_outbox_send() == APP_MSG_OK) {
+        live_in_flight = true;
+        live_sent_count = live_count;
+    }
 }
 
+/*
+ * Drops the oldest values, also when they are on the way already -
+ * the ack then takes only the rest of the sent ones
+ */
+static void live_drop(int count) {
+    count = MIN(count, live_count);
+    live_count -= count;
+    memmove(live_values, &live_values[count], live_count);
+    live_first_minute += count;
+    if (live_in_flight)
+        live_sent_count = live_sent_count > count ? live_sent_count - count : 0;
+}
 
-void in_received_handler(DictionaryIterator *received, void *context) {
-    D("in_received_handler:");
+static void live_sent(bool delivered) {
+    if (delivered) {
+        // Values may have come in meanwhile - keep them for the next batch
+        live_drop(live_sent_count);
+    }
+    live_in_flight = false;
+}
 
-    if (sync_in_progress) return;
-    if (sync_start) return;
+void live_minute_value(uint16_t minute, uint8_t value) {
+    if (!live_enabled)
+        return;
 
+    if (live_count > 0 && minute != live_first_minute + live_count) {
+        // A batch holds consecutive minutes. The ones before a gap or a
+        // new night go now or not at all, the next batch starts at minute.
+        live_flush();
+        live_drop(live_count);
+    }
+    if (live_count == 0) {
+        live_first_minute = minute;
+    } else if (live_count >= live_capacity()) {
+        // Phone away for long - drop the oldest, the minute index shows the gap
+        live_drop(1);
+    }
+    live_values[live_count++] = value;
+    live_last_time = time(NULL);
 
-    Tuple *command_tupple = dict_find(received, PS_APP_TO_WATCH_COMMAND);
+    if (live_count >= LIVE_BATCH_MINUTES || live_count >= live_capacity()) {
+        live_flush();
+    }
+}
+
+// ================== Command queue ======================
+// Commands from the phone are queued and run in order - right away,
+// or between the chunks while a sync is running. A sync request that
+// comes in meanwhile waits for that sync, the commands behind it do not.
+// A command that carries an id is acknowledged, so the phone does not
+// have to guess.
+#define COMMAND_QUEUE_SIZE 4
+#define MAX_PENDING_ACKS 8
+const int MAX_REPLY_RETRIES = 3;
+
+typedef struct {
+    uint8_t command;
+    uint8_t id;
+    uint8_t encoding;
+    uint8_t args[5];
+    bool incremental;
+    uint32_t hwm;
+    uint32_t offset;
+} Command;
+
+static Command command_queue[COMMAND_QUEUE_SIZE];
+static int command_head = 0;
+static int command_count = 0;
+
+// Id and status pairs waiting to go to the phone
+static uint8_t acks[2 * MAX_PENDING_ACKS];
+static int ack_count = 0;
+static int acks_in_flight = 0;
+static bool summary_requested = false;
+static bool summary_in_flight = false;
+static bool trace_requested = false;
+static bool trace_in_flight = false;
+static int reply_retries = 0;
+static AppTimer *timerReply;
+
+static void queue_ack(uint8_t id, uint8_t status) {
+    // Old phones send no id and get no ack
+    if (id == 0 || ack_count >= MAX_PENDING_ACKS)
+        return;
+    acks[2 * ack_count] = id;
+    acks[2 * ack_count + 1] = status;
+    ack_count++;
+}
 
-    if (command_tupple) {
-        if(command_tupple->value->uint8 == PS_APP_MESSAGE_COMMAND_START_SYNC) {
-            sync_start = true;
-            timerSync = app_timer_register(SYNC_STEP_MS, sync_timer_callback, NULL);
-        } else if (command_tupple->value->uint8 == PS_APP_MESSAGE_COMMAND_SET_TIME) {
+static uint8_t read_encoding(DictionaryIterator *received) {
+    Tuple *encoding_tupple = dict_find(received, PS_APP_TO_WATCH_SYNC_ENCODING);
+    if (encoding_tupple && encoding_tupple->value->uint8 == PS_SYNC_ENCODING_DELTA_RLE) {
+        return PS_SYNC_ENCODING_DELTA_RLE;
+    }
+    return PS_SYNC_ENCODING_RAW;
+}
+
+/*
+ * Copies what the command needs out of the message, which is gone after the handler
+ */
+static bool parse_command(DictionaryIterator *received, uint8_t command, Command *cmd) {
+    memset(cmd, 0, sizeof(Command));
+    cmd->command = command;
+
+    if (command == PS_APP_MESSAGE_COMMAND_START_SYNC) {
+        cmd->encoding = read_encoding(received);
+        Tuple *hwm_tupple = dict_find(received, PS_APP_TO_WATCH_SYNC_HWM);
+        Tuple *offset_tupple = dict_find(received, PS_APP_TO_WATCH_SYNC_OFFSET);
+        cmd->incremental = hwm_tupple != NULL;
+        cmd->hwm = hwm_tupple ? hwm_tupple->value->uint32 : 0;
+        cmd->offset = offset_tupple ? offset_tupple->value->uint32 : 0;
+    } else if (command == PS_APP_MESSAGE_COMMAND_EXPORT_HISTORY) {
+        cmd->encoding = read_encoding(received);
+    } else if (command == PS_APP_MESSAGE_COMMAND_SET_TIME) {
+        for (int i = 0; i < 4; i++) {
+            Tuple *t = dict_find(received, PS_APP_TO_WATCH_START_TIME_HOUR + i);
+            if (t == NULL)
+                return false;
+            cmd->args[i] = t->value->uint8;
+        }
+    } else if (command == PS_APP_MESSAGE_COMMAND_SET_SETTINGS) {
+        // snooze, fall asleep coef, sensitivity, profile, vibrate on change
+        for (int i = 0; i < 5; i++) {
+            Tuple *t = dict_find(received, PS_APP_TO_WATCH_COMMAND + 1 + i);
+            if (t == NULL)
+                return false;
+            cmd->args[i] = t->value->uint8;
+        }
+    } else if (command == PS_APP_MESSAGE_COMMAND_LIVE_STREAM) {
+        Tuple *enable_tupple = dict_find(received, PS_APP_TO_WATCH_LIVE_ENABLE);
+        cmd->args[0] = enable_tupple && enable_tupple->value->uint8 == YES;
+    } else if (command != PS_APP_MESSAGE_COMMAND_TOGGLE_SLEEP
+               && command != PS_APP_MESSAGE_COMMAND_GET_SYNC_STATS
+               && command != PS_APP_MESSAGE_COMMAND_GET_TRACE) {
+        return false;
+    }
+    return true;
+}
 
+/*
+ * False when the command has to wait - a sync runs one at a time
+ */
+static bool execute_command(Command *cmd) {
+    if (cmd->command == PS_APP_MESSAGE_COMMAND_START_SYNC
+            || cmd->command == PS_APP_MESSAGE_COMMAND_EXPORT_HISTORY) {
+        if (sync_start || sync_in_progress)
+            return false;
+        requested_encoding = cmd->encoding;
+        if (cmd->command == PS_APP_MESSAGE_COMMAND_START_SYNC) {
+            incremental_sync = cmd->incremental;
+            requested_hwm = cmd->hwm;
+            requested_offset = cmd->offset;
+            export_requested = false;
+        } else {
+            // The export talks the new protocol, but does not move the high-water mark
+            incremental_sync = true;
+            export_requested = true;
+        }
+        sync_start = true;
+        sync_metrics_requested();
+        timerSync = app_timer_register(SYNC_STEP_MS, sync_timer_callback, NULL);
+    } else if (cmd->command == PS_APP_MESSAGE_COMMAND_SET_TIME) {
+        // The sync has its own progress window up
+        if (!sync_in_progress)
             show_syncprogress_window();
 
-            Tuple *start_time_hour_tupple = dict_find(received, PS_APP_TO_WATCH_START_TIME_HOUR);
-            Tuple *start_time_minute_tupple = dict_find(received, PS_APP_TO_WATCH_START_TIME_MINUTE);
+        D("save start: %d:%d end: %d%d", cmd->args[0], cmd->args[1], cmd->args[2], cmd->args[3]);
 
-            Tuple *end_time_hour_tupple = dict_find(received, PS_APP_TO_WATCH_END_TIME_HOUR);
-            Tuple *end_time_minute_tupple = dict_find(received, PS_APP_TO_WATCH_END_TIME_MINUTE);
+        set_config_start_time(cmd->args[0], cmd->args[1]);
+        set_config_end_time(cmd->args[2], cmd->args[3]);
+        persist_write_config();
 
-            D("save start: %d:%d end: %d%d", start_time_hour_tupple->value->uint8, start_time_minute_tupple->value->uint8, end_time_hour_tupple->value->uint8, end_time_minute_tupple->value->uint8);
+        if (!sync_in_progress)
+            hide_syncprogress_window();
+    } else if (cmd->command == PS_APP_MESSAGE_COMMAND_LIVE_STREAM) {
+        live_enabled = cmd->args[0];
+        if (!live_enabled) {
+            live_drop(live_count);
+        }
+    } else if (cmd->command == PS_APP_MESSAGE_COMMAND_GET_SYNC_STATS) {
+        summary_requested = true;
+    } else if (cmd->command == PS_APP_MESSAGE_COMMAND_GET_TRACE) {
+        trace_requested = true;
+    } else if (cmd->command == PS_APP_MESSAGE_COMMAND_TOGGLE_SLEEP) {
+        toggle_sleep();
+    } else if (cmd->command == PS_APP_MESSAGE_COMMAND_SET_SETTINGS) {
+        if (!sync_in_progress)
+            show_syncprogress_window();
+
+        set_config_snooze(cmd->args[0]);
+        set_config_down_coef(cmd->args[1]);
+        set_config_up_coef(cmd->args[2]);
+        set_config_active_profile(cmd->args[3]);
+        set_config_vibrate_on_change(cmd->args[4]);
 
-            set_config_start_time(start_time_hour_tupple->value->uint8, start_time_minute_tupple->value->uint8);
-            set_config_end_time(end_time_hour_tupple->value->uint8, end_time_minute_tupple->value->uint8);
-            persist_write_config();
+        persist_write_config();
 
+        if (!sync_in_progress)
             hide_syncprogress_window();
-        } else if (command_tupple->value->uint8 == PS_APP_MESSAGE_COMMAND_TOGGLE_SLEEP) {
-            toggle_sleep();
-        } else if (command_tupple->value->uint8 == PS_APP_MESSAGE_COMMAND_SET_SETTINGS) {
+    }
+    return true;
+}
 
-            show_syncprogress_window();
+static void command_queue_drain() {
+    int kept = 0;
+    for (int i = 0; i < command_count; i++) {
+        Command *cmd = &command_queue[(command_head + i) % COMMAND_QUEUE_SIZE];
+        if (!execute_command(cmd)) {
+            // Stays in the queue, in order with the other waiting ones
+            Command *slot = &command_queue[(command_head + kept) % COMMAND_QUEUE_SIZE];
+            if (slot != cmd)
+                *slot = *cmd;
+            kept++;
+            continue;
+        }
+        queue_ack(cmd->id, PS_COMMAND_STATUS_DONE);
+    }
+    command_count = kept;
+}
 
-            Tuple *snoozeT = dict_find(received, PS_APP_TO_WATCH_COMMAND + 1);
-            Tuple *fallAsT = dict_find(received, PS_APP_TO_WATCH_COMMAND + 2);
-            Tuple *sensitivityT = dict_find(received, PS_APP_TO_WATCH_COMMAND + 3);
-            Tuple *profileT = dict_find(received, PS_APP_TO_WATCH_COMMAND + 4);
-            Tuple *vibrateOnSyncT = dict_find(received, PS_APP_TO_WATCH_COMMAND + 5);
+/*
+ * Acks and the sync summary go in one message - true when it is on the way
+ */
+static bool send_replies() {
+    if (reply_in_flight || live_in_flight)
+        return false;
+    if (ack_count == 0 && !summary_requested && !trace_requested)
+        return false;
 
-            set_config_snooze(snoozeT->value->uint8);
-            set_config_down_coef(fallAsT->value->uint8);
-            set_config_up_coef(sensitivityT->value->uint8);
-            set_config_active_profile(profileT->value->uint8);
-            set_config_vibrate_on_change(vibrateOnSyncT->value->uint8);
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK)
+        return false;
+    if (ack_count > 0) {
+        Tuplet value_acks = TupletBytes(PS_APP_MSG_COMMAND_ACKS, acks, 2 * ack_count);
+        dict_write_tuplet(iter, &value_acks);
+    }
+    if (summary_requested) {
+        // Summary of the last sync as stored - see SyncSummary for the layout
+        Tuplet value_summary = TupletBytes(PS_APP_MSG_SYNC_SUMMARY, (uint8_t *)sync_metrics_last(), sizeof(SyncSummary));
+        dict_write_tuplet(iter, &value_summary);
+    }
+    if (trace_requested) {
+        // Both rings - the worker one as it was last persisted
+        TraceRing worker_ring;
+        Tuplet value_app = TupletBytes(PS_APP_MSG_TRACE_APP, (uint8_t *)trace_ring(), sizeof(TraceRing));
+        dict_write_tuplet(iter, &value_app);
+        if (persist_read_data(TRACE_WORKER_KEY, &worker_ring, sizeof(TraceRing)) == sizeof(TraceRing)) {
+            Tuplet value_worker = TupletBytes(PS_APP_MSG_TRACE_WORKER, (uint8_t *)&worker_ring, sizeof(TraceRing));
+            dict_write_tuplet(iter, &value_worker);
+        }
+    }
+    dict_write_end(iter);
 
-            persist_write_config();
+    if (app_message_outbox_send() != APP_MSG_OK)
+        return false;
+    reply_in_flight = true;
+    acks_in_flight = ack_count;
+    summary_in_flight = summary_requested;
+    trace_in_flight = trace_requested;
+    return true;
+}
 
-            hide_syncprogress_window();
+static void reply_timer_callback() {
+    send_replies();
+}
+
+static void replies_sent(bool delivered) {
+    reply_in_flight = false;
+    // Failed ones are kept for the next try
+    if (delivered || ++reply_retries > MAX_REPLY_RETRIES) {
+        // Acks that came in meanwhile stay
+        ack_count -= acks_in_flight;
+        memmove(acks, &acks[2 * acks_in_flight], 2 * ack_count);
+        if (summary_in_flight)
+            summary_requested = false;
+        if (trace_in_flight)
+            trace_requested = false;
+        reply_retries = 0;
+    }
+    acks_in_flight = 0;
+    summary_in_flight = false;
+    trace_in_flight = false;
+
+    if (sync_in_progress) {
+        timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+    } else {
+        timerReply = app_timer_register(SEND_STEP_MS, reply_timer_callback, NULL);
+    }
+}
+
+void out_sent_handler(DictionaryIterator *sent, void *context) {
+    D("out_sent_handler:");
+    if (live_in_flight) {
+        live_sent(true);
+        send_replies();
+        return;
+    }
+    if (reply_in_flight) {
+        replies_sent(true);
+        return;
+    }
+    uint32_t ack_ms = timestamp_ms() - send_started_ms;
+    sync_metrics_sent(ack_ms, in_flight_bytes);
+    // Additive increase, but only when the message used the whole size
+    if (ack_ms < (uint32_t)CHUNK_FAST_ACK_MS && in_flight_bytes + CHUNK_STEP_BYTES > chunk_bytes) {
+        chunk_bytes = MIN(chunk_bytes + CHUNK_STEP_BYTES, message_outbox_size);
+    }
+
+    sendData.retries = 0;
+    sendData.position += sendData.in_flight;
+    sendData.in_flight = 0;
+    sendData.currentSendChunk += 1;
+    timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+}
+
+
+void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+    D("out_failed_handler:");
+    if (live_in_flight) {
+        // No retries - the values go with the next batch
+        live_sent(false);
+        send_replies();
+        return;
+    }
+    if (reply_in_flight) {
+        replies_sent(false);
+        return;
+    }
+
+    if (reason == APP_MSG_BUSY || reason == APP_MSG_SEND_TIMEOUT) {
+        // Multiplicative decrease
+        chunk_bytes = MAX(chunk_bytes / 2, CHUNK_MIN_BYTES);
+    }
+    sendData.in_flight = 0;
+
+    // Give up when the phone is gone - it resumes with the next START_SYNC
+    sendData.retries++;
+    sync_metrics_failed(reason, sendData.retries);
+    if (sendData.retries > MAX_SEND_RETRIES) {
+        finish_sync(false);
+        return;
+    }
+
+    // Repeat lst chunk - do not increment the currentSendChunk
+    timerSend = app_timer_register(SEND_STEP_MS, send_timer_callback, NULL);
+}
+
+
+void in_received_handler(DictionaryIterator *received, void *context) {
+    D("in_received_handler:");
+
+    Tuple *command_tupple = dict_find(received, PS_APP_TO_WATCH_COMMAND);
+    if (!command_tupple)
+        return;
+    Tuple *id_tupple = dict_find(received, PS_APP_TO_WATCH_COMMAND_ID);
+    uint8_t id = id_tupple ? id_tupple->value->uint8 : 0;
+
+    if (command_count >= COMMAND_QUEUE_SIZE) {
+        D("Command queue full, %d rejected", command_tupple->value->uint8);
+        queue_ack(id, PS_COMMAND_STATUS_QUEUE_FULL);
+    } else {
+        Command *cmd = &command_queue[(command_head + command_count) % COMMAND_QUEUE_SIZE];
+        if (parse_command(received, command_tupple->value->uint8, cmd)) {
+            cmd->id = id;
+            command_count++;
+        } else {
+            queue_ack(id, PS_COMMAND_STATUS_INVALID);
         }
     }
+
+    // While syncing the send timer takes care of them
+    if (!sync_in_progress) {
+        command_queue_drain();
+        send_replies();
+    }
 }
 
 
 void in_dropped_handler(AppMessageResult reason, void *context) {
     D("in_dropped_handler:");
+    sync_metrics_dropped();
 }
 
 void set_outbox_size(int outbox_size) {
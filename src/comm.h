@@ -40,4 +40,6 @@ void in_dropped_handler(AppMessageResult reason, void *context);
 
 void set_outbox_size(int outbox_size);
 
+void live_minute_value(uint16_t minute, uint8_t value);
+
 #endif
@@ -50,6 +50,21 @@ typedef struct {
 } SleepData;
 
 
+// Minutes of the running night kept for the live view
+#define LIVE_RECENT_MINUTES 60
+// Recent value of a minute the app did not get from the worker
+#define LIVE_GAP 0xFF
+
+typedef struct {
+    bool valid;
+    uint16_t minutes;
+    uint8_t value;
+    uint8_t phase;
+    // Last values, oldest first
+    uint8_t recent[LIVE_RECENT_MINUTES];
+    uint8_t recent_count;
+} LiveData;
+
 #define MODE_WORKDAY 0
 #define MODE_WEEKEND 1
 
@@ -102,15 +117,64 @@ typedef struct {
 #define PS_APP_TO_WATCH_START_TIME_MINUTE 4
 #define PS_APP_TO_WATCH_END_TIME_HOUR 5
 #define PS_APP_TO_WATCH_END_TIME_MINUTE 6
+// Optional with START_SYNC - the encoding the phone is able to decode
+#define PS_APP_TO_WATCH_SYNC_ENCODING 2
+// Optional with START_SYNC - last night the phone has and how much of the next one
+#define PS_APP_TO_WATCH_SYNC_HWM 7
+#define PS_APP_TO_WATCH_SYNC_OFFSET 8
+// With LIVE_STREAM - YES to get the minute values while tracking
+#define PS_APP_TO_WATCH_LIVE_ENABLE 2
+// Optional with any command - the watch acknowledges it with this id (1-255)
+#define PS_APP_TO_WATCH_COMMAND_ID 9
 
 #define PS_APP_MESSAGE_COMMAND_START_SYNC  21
 #define PS_APP_MESSAGE_COMMAND_SET_TIME 22
 #define PS_APP_MESSAGE_COMMAND_TOGGLE_SLEEP 23
 #define PS_APP_MESSAGE_COMMAND_SET_SETTINGS 24
+#define PS_APP_MESSAGE_COMMAND_EXPORT_HISTORY 25
+#define PS_APP_MESSAGE_COMMAND_LIVE_STREAM 26
+#define PS_APP_MESSAGE_COMMAND_GET_SYNC_STATS 27
+#define PS_APP_MESSAGE_COMMAND_GET_TRACE 28
 
 #define PS_APP_MSG_HEADER_START 0
 #define PS_APP_MSG_HEADER_END 1
 #define PS_APP_MSG_HEADER_COUNT 2
+// Keys 3.. are the raw motion values, so extended keys start well above them
+#define PS_APP_MSG_HEADER_ENCODING 1000
+#define PS_APP_MSG_HEADER_ENCODED_SIZE 1001
+#define PS_APP_MSG_HEADER_ENCODE_MS 1002
+#define PS_APP_MSG_DATA_OFFSET 1003
+#define PS_APP_MSG_DATA_BYTES 1004
+#define PS_APP_MSG_HEADER_SEQ 1005
+#define PS_APP_MSG_HEADER_STATS 1006
+#define PS_APP_MSG_HEADER_OFFSET 1007
+#define PS_APP_MSG_SYNC_DONE 1008
+#define PS_APP_MSG_SYNC_BYTES_PER_SEC 1009
+#define PS_APP_MSG_SYNC_RETRIES 1010
+// History export - StatData records as stored, little endian
+#define PS_APP_MSG_EXPORT_FIRST_SEQ 1011
+#define PS_APP_MSG_EXPORT_TOTAL 1012
+#define PS_APP_MSG_EXPORT_RECORDS 1013
+// Live batch - values of consecutive minutes of the running night
+#define PS_APP_MSG_LIVE_FIRST_MINUTE 1014
+#define PS_APP_MSG_LIVE_TIME 1015
+#define PS_APP_MSG_LIVE_VALUES 1016
+// SyncSummary of the last sync as bytes
+#define PS_APP_MSG_SYNC_SUMMARY 1017
+// Byte pairs of command id and status
+#define PS_APP_MSG_COMMAND_ACKS 1018
+// WorkerCounters of the last night as bytes, in its header
+#define PS_APP_MSG_HEADER_WORKER_COUNTERS 1019
+// TraceRing of the app and of the worker as bytes, see trace.h
+#define PS_APP_MSG_TRACE_APP 1020
+#define PS_APP_MSG_TRACE_WORKER 1021
+
+#define PS_COMMAND_STATUS_DONE 0
+#define PS_COMMAND_STATUS_QUEUE_FULL 1
+#define PS_COMMAND_STATUS_INVALID 2
+
+#define PS_SYNC_ENCODING_RAW 0
+#define PS_SYNC_ENCODING_DELTA_RLE 1
 
 typedef enum {
     DEEP = 1,
@@ -122,11 +186,21 @@ typedef enum {
 typedef struct {
     int countTuplets;
     int currentSendChunk;
-    int sendChunkSize;
+    int position;
+    int in_flight;
     uint32_t start_time;
     uint32_t end_time;
     uint16_t count_values;
     uint8_t *motionData;
+    int encoding;
+    uint16_t encoded_size;
+    uint16_t encode_ms;
+    uint32_t seq;
+    uint32_t last_seq;
+    uint16_t stat[COUNT_PHASES];
+    int offset;
+    bool done_sent;
+    int retries;
 } SendData;
 
 #define CONFIG_PERSISTENT_KEY 0
@@ -151,6 +225,24 @@ typedef struct {
 
 // Max persistem
 #define COUNT_STATS_KEY 100
+// Sequence number of the last stored night - the stats are numbered back from it
+#define NIGHT_SEQ_KEY 101
+// Last message size the sync settled on
+#define CHUNK_SIZE_KEY 103
+// SyncSummary of the last sync
+#define SYNC_SUMMARY_KEY 104
+// DiagRecord - heap and stack high-water marks of the app
+#define DIAG_KEY 106
+// WorkerDiag - heap high-water marks of the worker
+#define WORKER_DIAG_KEY 107
+// WorkerCounters of the last stored night
+#define WORKER_COUNTERS_KEY 108
+// TraceRing of the app and of the worker
+#define TRACE_APP_KEY 110
+#define TRACE_WORKER_KEY 111
+// WriteAccount of the app and of the worker, debug builds only
+#define WRITE_ACCOUNT_APP_KEY 112
+#define WRITE_ACCOUNT_WORKER_KEY 113
 #define VERSION_KEY 254
 
 #define MAX_PERSIST_BUFFER 240
@@ -161,7 +253,43 @@ typedef struct {
     uint16_t stat[COUNT_PHASES];
 } StatData;
 
+typedef struct {
+    uint16_t heap_peak;
+    uint16_t heap_min_free;
+} WorkerDiag;
+
+// What the worker did during the night
+typedef struct {
+    uint32_t motion_runs;       // accelerometer samples taken
+    uint32_t calc_ms_total;     // minute value calculation
+    uint32_t alarm_ms_total;    // alarm check
+    uint16_t peek_failures;     // accel_service_peek -1/-2
+    uint16_t vibrate_skips;     // samples taken while vibrating
+    uint16_t minute_ticks;
+    uint16_t calc_ms_max;
+    uint16_t alarm_ms_max;
+    uint16_t persist_reads;
+    uint16_t persist_writes;
+    uint16_t reserved;
+} WorkerCounters;
+
+// Wall clock in milliseconds - only differences are meaningful
+static inline uint32_t timestamp_ms() {
+    time_t sec;
+    uint16_t ms;
+    time_ms(&sec, &ms);
+    return (uint32_t)sec * 1000 + ms;
+}
+
 #define WORKER_CMD_EXEC_ALARM 0
+#define WORKER_CMD_STARTED 1
+// data0 - minute index, data1 - value on the 0-255 scale, data2 - phase
+#define WORKER_CMD_MINUTE_VALUE 2
+// Same as MINUTE_VALUE, the state when the app opens - not a new minute
+#define WORKER_CMD_LIVE_SNAPSHOT 3
 #define APP_CMD_STOP_CAPTURING 100
+// The worker sends the minute values only while the app is open
+#define APP_CMD_APP_OPEN 101
+#define APP_CMD_APP_CLOSED 102
 
 #endif
@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+
+#include "diagnostics.h"
+#include "logic.h"
+#include "write_account.h"
+
+/*
+ * High-water marks only - a sample is a couple of compares, the record
+ * goes to flash once when the app exits and only if it changed
+ */
+static DiagRecord record = { .heap_min_free = UINT16_MAX };
+static bool loaded = false;
+static bool dirty = false;
+static uintptr_t stack_base = 0;
+
+static const char *point_names[DIAG_POINTS] = {
+    "sleep", "stats", "alarm", "menu", "sync win", "live", "locale", "sync"
+};
+
+void diag_init() {
+    char here;
+    stack_base = (uintptr_t)&here;
+}
+
+void diag_load() {
+    if (loaded)
+        return;
+    loaded = true;
+    DiagRecord stored;
+    if (persist_read_data(DIAG_KEY, &stored, sizeof(DiagRecord)) != sizeof(DiagRecord))
+        return;
+
+    // Keep what was sampled before the read - a write only if it moved a mark
+    dirty = false;
+    for (int i = 0; i < DIAG_POINTS; i++) {
+        if (stored.heap_peak[i] > record.heap_peak[i])
+            record.heap_peak[i] = stored.heap_peak[i];
+        else if (record.heap_peak[i] > stored.heap_peak[i])
+            dirty = true;
+    }
+    if (stored.heap_min_free <= record.heap_min_free) {
+        record.heap_min_free = stored.heap_min_free;
+        record.min_free_point = stored.min_free_point;
+    } else {
+        dirty = true;
+    }
+    if (stored.stack_peak > record.stack_peak)
+        record.stack_peak = stored.stack_peak;
+    else if (record.stack_peak > stored.stack_peak)
+        dirty = true;
+    record.runs = stored.runs;
+}
+
+void diag_sample(DiagPoint point) {
+    char here;
+    int used = heap_bytes_used();
+    int free_bytes = heap_bytes_free();
+
+    if (used > record.heap_peak[point]) {
+        record.heap_peak[point] = used;
+        dirty = true;
+    }
+    if (free_bytes < record.heap_min_free) {
+        record.heap_min_free = free_bytes;
+        record.min_free_point = point;
+        dirty = true;
+    }
+    // The stack grows down
+    int depth = stack_base - (uintptr_t)&here;
+    if (stack_base != 0 && depth > record.stack_peak) {
+        record.stack_peak = depth;
+        dirty = true;
+    }
+    D("Heap at %s: %d used, %d free", point_names[point], used, free_bytes);
+}
+
+void diag_persist() {
+    // The app may leave before the deferred read
+    diag_load();
+    if (!dirty)
+        return;
+    // Counted with the write - a run that moved nothing costs no flash
+    if (record.runs < UINT8_MAX)
+        record.runs++;
+    persist_write_data(DIAG_KEY, &record, sizeof(DiagRecord));
+    dirty = false;
+}
+
+void diag_reset() {
+    memset(&record, 0, sizeof(DiagRecord));
+    record.heap_min_free = UINT16_MAX;
+    loaded = true;
+    dirty = true;
+    persist_delete(WORKER_DIAG_KEY);
+}
+
+const DiagRecord *diag_record() {
+    diag_load();
+    return &record;
+}
+
+const char *diag_point_name(int point) {
+    if (point < 0 || point >= DIAG_POINTS)
+        return "?";
+    return point_names[point];
+}
@@ -0,0 +1,64 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PebSlee_diagnostics_h
+#define PebSlee_diagnostics_h
+
+#include <pebble.h>
+
+// Where the heap is sampled - windows on push and unload, subsystems
+// when they are done with their buffers
+typedef enum {
+    DIAG_SLEEP_WINDOW = 0,
+    DIAG_STATS_WINDOW,
+    DIAG_ALARM_WINDOW,
+    DIAG_MENU_WINDOW,
+    DIAG_SYNC_WINDOW,
+    DIAG_LIVE_WINDOW,
+    DIAG_LOCALE,
+    DIAG_SYNC,
+    DIAG_POINTS
+} DiagPoint;
+
+typedef struct {
+    uint16_t heap_peak[DIAG_POINTS];
+    uint16_t heap_min_free;
+    uint8_t min_free_point;
+    uint8_t runs;            // runs that moved a mark
+    uint16_t stack_peak;     // bytes below the frame of main
+} DiagRecord;
+
+// First thing in main - the stack depth is measured from there
+void diag_init();
+// Reads the stored marks - deferred, off the launch path
+void diag_load();
+void diag_sample(DiagPoint point);
+// Writes the record if a mark moved
+void diag_persist();
+void diag_reset();
+const DiagRecord *diag_record();
+const char *diag_point_name(int point);
+
+void show_diagnostics_window(void);
+
+#endif
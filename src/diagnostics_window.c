@@ -0,0 +1,194 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+
+#include "diagnostics.h"
+#include "startup.h"
+#include "logic.h"
+#include "write_account.h"
+
+/*
+ * Hidden page of the action menu - long select on the version row.
+ * SELECT clears the marks.
+ */
+#ifdef WRITE_ACCOUNTING
+#define DIAG_TEXT_BYTES 1280
+// Keys listed per account, the most bytes first
+#define DIAG_HOT_KEYS 4
+#else
+#define DIAG_TEXT_BYTES 768
+#endif
+
+static Window *s_window;
+static ScrollLayer *s_scroll;
+static TextLayer *s_text;
+static char *text_buffer;
+
+#ifdef WRITE_ACCOUNTING
+static int fill_account(int len, const char *name, const WriteAccount *account) {
+    if (len >= DIAG_TEXT_BYTES)
+        return len;
+    len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len,
+            "%s flash (%d runs)\n writes: %ld same: %d\n bytes: %ld changed: %ld\n keys: %d\n",
+            name, account->runs, account->writes, account->unchanged,
+            account->bytes, account->changed_bytes, account->slots_used);
+
+    bool shown[WRITE_ACCOUNT_SLOTS];
+    memset(shown, 0, sizeof(shown));
+    for (int n = 0; n < DIAG_HOT_KEYS && len < DIAG_TEXT_BYTES; n++) {
+        int hot = -1;
+        for (int i = 0; i < account->slots_used && i < WRITE_ACCOUNT_SLOTS; i++) {
+            if (!shown[i] && (hot < 0 || account->key_bytes[i] > account->key_bytes[hot]))
+                hot = i;
+        }
+        if (hot < 0)
+            break;
+        shown[hot] = true;
+        if (account->key[hot] == WRITE_ACCOUNT_OTHER) {
+            len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, " other: %dx %ld B\n",
+                    account->key_writes[hot], account->key_bytes[hot]);
+        } else {
+            len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, " key %d: %dx %ld B\n",
+                    account->key[hot], account->key_writes[hot], account->key_bytes[hot]);
+        }
+    }
+    return len;
+}
+#endif
+
+static void fill_text() {
+    const DiagRecord *rec = diag_record();
+    int len = 0;
+
+    len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, "Heap peak (%d runs)\n", rec->runs);
+    for (int i = 0; i < DIAG_POINTS && len < DIAG_TEXT_BYTES; i++) {
+        len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, " %s: %d\n", diag_point_name(i), rec->heap_peak[i]);
+    }
+    if (len < DIAG_TEXT_BYTES) {
+        len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, "Min free: %d at %s\nStack: %d\n",
+                rec->heap_min_free == UINT16_MAX ? 0 : rec->heap_min_free,
+                diag_point_name(rec->min_free_point), rec->stack_peak);
+    }
+
+    WorkerDiag worker = { 0, 0 };
+    persist_read_data(WORKER_DIAG_KEY, &worker, sizeof(WorkerDiag));
+    if (len < DIAG_TEXT_BYTES) {
+        len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, "Worker peak: %d\nWorker min free: %d\n",
+                worker.heap_peak, worker.heap_min_free);
+    }
+
+    WorkerCounters counters;
+    if (len < DIAG_TEXT_BYTES &&
+        persist_read_data(WORKER_COUNTERS_KEY, &counters, sizeof(WorkerCounters)) == sizeof(WorkerCounters)) {
+        len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len,
+                "Last night\n samples: %ld\n peek fails: %d\n vibrate: %d\n ticks: %d\n"
+                " calc ms: %ld max %d\n alarm ms: %ld max %d\n flash r/w: %d/%d\n",
+                counters.motion_runs, counters.peek_failures, counters.vibrate_skips, counters.minute_ticks,
+                counters.calc_ms_total, counters.calc_ms_max, counters.alarm_ms_total, counters.alarm_ms_max,
+                counters.persist_reads, counters.persist_writes);
+    }
+
+#ifdef WRITE_ACCOUNTING
+    len = fill_account(len, "App", write_account());
+    WriteAccount worker_account;
+    if (persist_read_data(WRITE_ACCOUNT_WORKER_KEY, &worker_account, sizeof(WriteAccount)) == sizeof(WriteAccount)) {
+        len = fill_account(len, "Worker", &worker_account);
+    }
+#endif
+
+    if (len < DIAG_TEXT_BYTES) {
+        len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, "Startup ms\n");
+    }
+    const StartupMark *marks = startup_marks();
+    for (int i = 0; i < startup_mark_count() && len < DIAG_TEXT_BYTES; i++) {
+        len += snprintf(text_buffer + len, DIAG_TEXT_BYTES - len, " %s: %d\n", marks[i].phase, marks[i].ms);
+    }
+}
+
+static void layout_text() {
+    fill_text();
+    text_layer_set_text(s_text, text_buffer);
+    GSize size = text_layer_get_content_size(s_text);
+    GRect bounds = layer_get_bounds(window_get_root_layer(s_window));
+    text_layer_set_size(s_text, GSize(bounds.size.w, size.h + 8));
+    scroll_layer_set_content_size(s_scroll, GSize(bounds.size.w, size.h + 8));
+}
+
+static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
+    diag_reset();
+    write_account_reset();
+    layout_text();
+}
+
+static void click_config_provider(void *context) {
+    window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
+}
+
+static void initialise_ui(void) {
+    s_window = window_create();
+#ifndef PBL_SDK_3
+    window_set_fullscreen(s_window, false);
+#endif
+
+    Layer *window_layer = window_get_root_layer(s_window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    s_scroll = scroll_layer_create(bounds);
+    scroll_layer_set_click_config_onto_window(s_scroll, s_window);
+    scroll_layer_set_callbacks(s_scroll, (ScrollLayerCallbacks) {
+        .click_config_provider = click_config_provider
+    });
+    layer_add_child(window_layer, scroll_layer_get_layer(s_scroll));
+
+    s_text = text_layer_create(GRect(0, 0, bounds.size.w, 2000));
+    text_layer_set_font(s_text, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+    scroll_layer_add_child(s_scroll, text_layer_get_layer(s_text));
+}
+
+static void destroy_ui(void) {
+    window_destroy(s_window);
+    text_layer_destroy(s_text);
+    scroll_layer_destroy(s_scroll);
+}
+
+static void handle_window_unload(Window* window) {
+    destroy_ui();
+    free(text_buffer);
+    text_buffer = NULL;
+}
+
+void show_diagnostics_window(void) {
+    // Only while shown - the page is rarely opened
+    text_buffer = malloc(DIAG_TEXT_BYTES);
+    if (text_buffer == NULL) {
+        D("Error allocating diagnostics text");
+        return;
+    }
+    initialise_ui();
+    window_set_window_handlers(s_window, (WindowHandlers) {
+        .unload = handle_window_unload,
+    });
+    layout_text();
+    window_stack_push(s_window, true);
+}
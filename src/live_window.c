@@ -0,0 +1,151 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+#include "live_window.h"
+#include "logic.h"
+#include "localize.h"
+#include "ui_util.h"
+#include "diagnostics.h"
+
+/*
+ * The night being tracked, from the worker telemetry kept by logic.c.
+ * Each message changes the texts that differ and redraws the graph.
+ */
+#define GRAPH_BAR_WIDTH 2
+#define GRAPH_HEIGHT 56
+
+static Window *s_window;
+static GFont s_res_gothic_24_bold;
+static GFont s_res_roboto_condensed_21;
+static TextLayer *s_tl_phase;
+static TextLayer *s_tl_duration;
+static Layer *s_graph;
+
+static char phase_lbl[LOCALE_SLOT_BYTES];
+static char duration_lbl[8];
+
+static void graph_update_proc(Layer *layer, GContext *ctx) {
+    LiveData *live = read_live_data();
+    GRect b = layer_get_bounds(layer);
+    graphics_context_set_fill_color(ctx, GColorWhite);
+    // Newest minute on the right
+    int x = b.size.w - live->recent_count * GRAPH_BAR_WIDTH;
+    for (int i = 0; i < live->recent_count; i++, x += GRAPH_BAR_WIDTH) {
+        // A missing minute leaves a hole, a quiet one still has its base line
+        if (live->recent[i] == LIVE_GAP)
+            continue;
+        int h = MAX(live->recent[i] * b.size.h / 255, 1);
+        graphics_fill_rect(ctx, GRect(x, b.size.h - h, GRAPH_BAR_WIDTH, h), 0, GCornerNone);
+    }
+}
+
+static void initialise_ui(void) {
+    s_window = window_create();
+    window_set_background_color(s_window, GColorBlack);
+#ifndef PBL_SDK_3
+    window_set_fullscreen(s_window, false);
+#endif
+
+    Layer *window_layer = window_get_root_layer(s_window);
+    GRect b = layer_get_bounds(window_layer);
+
+    int hd = 0;
+#if defined(PBL_ROUND)
+    hd = (b.size.h - 168)/2;
+#endif
+
+    s_res_gothic_24_bold = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
+    s_res_roboto_condensed_21 = fonts_get_system_font(FONT_KEY_ROBOTO_CONDENSED_21);
+
+    // s_tl_phase
+    s_tl_phase = text_layer_create(GRect(0, 16+hd, b.size.w, 30));
+    text_layer_set_background_color(s_tl_phase, GColorClear);
+    text_layer_set_text_color(s_tl_phase, GColorWhite);
+    text_layer_set_text_alignment(s_tl_phase, GTextAlignmentCenter);
+    text_layer_set_font(s_tl_phase, s_res_gothic_24_bold);
+    layer_add_child(window_layer, (Layer *)s_tl_phase);
+
+    // s_tl_duration
+    s_tl_duration = text_layer_create(GRect(0, 48+hd, b.size.w, 26));
+    text_layer_set_background_color(s_tl_duration, GColorClear);
+    text_layer_set_text_color(s_tl_duration, GColorWhite);
+    text_layer_set_text_alignment(s_tl_duration, GTextAlignmentCenter);
+    text_layer_set_font(s_tl_duration, s_res_roboto_condensed_21);
+    layer_add_child(window_layer, (Layer *)s_tl_duration);
+
+    // s_graph
+    int width = LIVE_RECENT_MINUTES * GRAPH_BAR_WIDTH;
+    s_graph = layer_create(GRect((b.size.w - width) / 2, 88+hd, width, GRAPH_HEIGHT));
+    layer_set_update_proc(s_graph, graph_update_proc);
+    layer_add_child(window_layer, s_graph);
+}
+
+static void destroy_ui(void) {
+    window_destroy(s_window);
+    text_layer_destroy(s_tl_phase);
+    text_layer_destroy(s_tl_duration);
+    layer_destroy(s_graph);
+    s_window = NULL;
+}
+
+void refresh_live_window(void) {
+    if (s_window == NULL)
+        return;
+    LiveData *live = read_live_data();
+    if (!live->valid) {
+        // Nothing yet, or the night started over
+        set_label(s_tl_phase, phase_lbl, sizeof(phase_lbl), _("Unknown"));
+        set_label(s_tl_duration, duration_lbl, sizeof(duration_lbl), "");
+        layer_mark_dirty(s_graph);
+        return;
+    }
+    set_label(s_tl_phase, phase_lbl, sizeof(phase_lbl), decode_phase(live->phase));
+
+    char text[8];
+    snprintf(text, sizeof(text), "%d:%02d", live->minutes / 60, live->minutes % 60);
+    set_label(s_tl_duration, duration_lbl, sizeof(duration_lbl), text);
+
+    layer_mark_dirty(s_graph);
+}
+
+static void handle_window_unload(Window* window) {
+    destroy_ui();
+    diag_sample(DIAG_LIVE_WINDOW);
+}
+
+void show_live_window(void) {
+    initialise_ui();
+    window_set_window_handlers(s_window, (WindowHandlers) {
+        .unload = handle_window_unload,
+    });
+    phase_lbl[0] = duration_lbl[0] = '\0';
+    refresh_live_window();
+    window_stack_push(s_window, true);
+    diag_sample(DIAG_LIVE_WINDOW);
+}
+
+void hide_live_window(void) {
+    if (s_window != NULL)
+        window_stack_remove(s_window, true);
+}
@@ -0,0 +1,47 @@
+// Generated by gen_dict.py - do not edit
+#pragma once
+
+#include <stdint.h>
+
+#define LOCALE_STRING_COUNT 32
+#define LOCALE_ID_NONE -1
+
+// Index in the hash sorted table of the locale resources. A hash
+// collision would be a duplicate case - the build fails on it.
+static inline __attribute__((always_inline)) int locale_id(uint32_t hashval) {
+  switch (hashval) {
+    case 38674124u: return 0; /* 30 min */
+    case 47977742u: return 1; /* with alarm */
+    case 159149554u: return 2; /* Not active */
+    case 198278302u: return 3; /* 5 min */
+    case 215622862u: return 4; /* Awake */
+    case 218538237u: return 5; /* Deep: */
+    case 412541264u: return 6; /* Sensitivity */
+    case 456898101u: return 7; /* Unknown */
+    case 463674491u: return 8; /* Clear stats */
+    case 603000054u: return 9; /* Profile */
+    case 643243315u: return 10; /* track sleep */
+    case 697799247u: return 11; /* View stats */
+    case 842685455u: return 12; /* no alarm */
+    case 947626518u: return 13; /* Light sleep */
+    case 981683797u: return 14; /* unknown */
+    case 1087202839u: return 15; /* Light: */
+    case 1156826014u: return 16; /* Fall asleep */
+    case 1172989326u: return 17; /* Normal */
+    case 1280314725u: return 18; /* Very sensitive */
+    case 1359882618u: return 19; /* 7 days alarm */
+    case 1367375555u: return 20; /* Snooze */
+    case 1368725443u: return 21; /* TOTAL: */
+    case 1404621867u: return 22; /* Version: 1.11 */
+    case 1468218121u: return 23; /* not tracking */
+    case 1715242957u: return 24; /* Set alarm time */
+    case 1778281922u: return 25; /* REM sleep */
+    case 1802617252u: return 26; /* 5/2 with alarm */
+    case 1946918076u: return 27; /* Deep sleep */
+    case 1981714352u: return 28; /* Not sensitive */
+    case 2089098739u: return 29; /* Fast */
+    case 2089577770u: return 30; /* Slow */
+    case 2107886986u: return 31; /* 10 min */
+    default: return LOCALE_ID_NONE;
+  }
+}
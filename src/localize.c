@@ -1,9 +1,36 @@
 #include <pebble.h>
-  
-DictionaryIterator s_locale_dict;
+#include "localize.h"
+#include "logic.h"
+
+// Resource layout written by gen_dict.py: entry count, the index sorted
+// by hash and the null terminated strings.
+typedef struct {
+  uint32_t hashval;
+  uint32_t offset;
+} LocaleEntry;
+
+static int s_locale_entries = 0;
+
+#ifdef LOCALE_EAGER
+// The whole resource is loaded as it is and the strings are used in place
+static uint8_t *s_locale_buffer = NULL;
+static const LocaleEntry *s_locale_index = NULL;
+static const char *s_locale_strings = NULL;
+#else
+// Strings are read on first use into fixed slots, the least recently
+// used slot is reused when all are taken
+static ResHandle s_locale_handle = NULL;
+static int s_locale_size = 0;
+static int s_strings_offset = 0;
+static char s_cache[LOCALE_CACHE_SLOTS][LOCALE_SLOT_BYTES];
+static int16_t s_cache_id[LOCALE_CACHE_SLOTS];
+static uint32_t s_cache_used[LOCALE_CACHE_SLOTS];
+static int8_t s_slot_of[LOCALE_STRING_COUNT];
+static uint32_t s_cache_tick = 0;
+#endif
 
 void locale_init(void) {
-  //hard-coded for testing 
+  //hard-coded for testing
   // const char* locale_str = "es";
 
   // Detect system locale
@@ -12,7 +39,7 @@ void locale_init(void) {
 #ifdef PBL_SDK_3
   char *sys_locale = setlocale(LC_ALL, locale_str);
 #endif
-    
+
   ResHandle locale_handle = NULL;
   int locale_size = 0;
 
@@ -33,45 +60,128 @@ void locale_init(void) {
     locale_size = resource_size(locale_handle);
   }
 
-  int resource_offset = 0;
-  int locale_entries = 0;
-  resource_offset += resource_load_byte_range(locale_handle, resource_offset, 
-      (uint8_t*)&locale_entries, sizeof(locale_entries));
+#ifdef DEBUG
+  int heap_before = heap_bytes_used();
+  uint32_t started = timestamp_ms();
+#endif
 
-  struct locale {
-    int32_t hashval;
-    int32_t strlen;
-  } locale_info;
+#ifdef LOCALE_EAGER
+  s_locale_buffer = malloc(locale_size);
+  if (s_locale_buffer == NULL) {
+    D("Error allocating locale of %d bytes", locale_size);
+    return;
+  }
+  resource_load_byte_range(locale_handle, 0, s_locale_buffer, locale_size);
 
-  int dict_buffer_size = locale_size + 7 * locale_entries; //7 byte header per item
-  char *dict_buffer = malloc(dict_buffer_size);
-  dict_write_begin(&s_locale_dict, (uint8_t*)dict_buffer, dict_buffer_size);
+  int entries = *(uint32_t *)s_locale_buffer;
+#else
+  uint32_t entries = 0;
+  resource_load_byte_range(locale_handle, 0, (uint8_t *)&entries, sizeof(entries));
+#endif
+  int strings_offset = sizeof(uint32_t) + entries * sizeof(LocaleEntry);
+  if (strings_offset > locale_size) {
+    D("Broken locale resource, %d entries in %d bytes", (int)entries, locale_size);
+#ifdef LOCALE_EAGER
+    free(s_locale_buffer);
+    s_locale_buffer = NULL;
+#endif
+    return;
+  }
+#ifdef LOCALE_EAGER
+  s_locale_index = (const LocaleEntry *)(s_locale_buffer + sizeof(uint32_t));
+  s_locale_strings = (const char *)(s_locale_buffer + strings_offset);
+#else
+  s_locale_handle = locale_handle;
+  s_locale_size = locale_size;
+  s_strings_offset = strings_offset;
+  for (int i = 0; i < LOCALE_CACHE_SLOTS; i++) {
+    s_cache_id[i] = LOCALE_ID_NONE;
+  }
+  for (int i = 0; i < LOCALE_STRING_COUNT; i++) {
+    s_slot_of[i] = -1;
+  }
+#endif
+  s_locale_entries = entries;
+  if (entries != LOCALE_STRING_COUNT) {
+    D("Locale has %d strings, the build expects %d", (int)entries, LOCALE_STRING_COUNT);
+  }
 
-  for (int i = 0; i < locale_entries; i++) {
-    resource_offset += resource_load_byte_range(locale_handle, resource_offset, 
-        (uint8_t*)&locale_info, sizeof(struct locale));
+  D("Locale %s: %d strings, %d bytes heap, %ld ms", locale_str, (int)entries,
+    heap_bytes_used() - heap_before, timestamp_ms() - started);
+}
 
-    struct Tuplet tupl = {
-      .type = TUPLE_CSTRING, 
-      .key = locale_info.hashval, 
-      .cstring.length = locale_info.strlen};
+#ifdef LOCALE_EAGER
+char *locale_str_id(int id) {
+  if (id < 0 || id >= s_locale_entries) {
+    return "\7";
+  }
+  return (char *)&s_locale_strings[s_locale_index[id].offset];
+}
+#else
+static int cache_victim() {
+  int victim = 0;
+  for (int i = 0; i < LOCALE_CACHE_SLOTS; i++) {
+    if (s_cache_id[i] == LOCALE_ID_NONE) {
+      return i;
+    }
+    if (s_cache_used[i] < s_cache_used[victim]) {
+      victim = i;
+    }
+  }
+  return victim;
+}
 
-    tupl.cstring.data = malloc(tupl.cstring.length);
+char *locale_str_id(int id) {
+  if (id < 0 || id >= s_locale_entries || id >= LOCALE_STRING_COUNT) {
+    return "\7";
+  }
+  int slot = s_slot_of[id];
+  if (slot < 0) {
+    slot = cache_victim();
+    if (s_cache_id[slot] != LOCALE_ID_NONE) {
+      s_slot_of[s_cache_id[slot]] = -1;
+    }
 
-    resource_offset += resource_load_byte_range(locale_handle, 
-        resource_offset, (uint8_t*)tupl.cstring.data, tupl.cstring.length);
+    uint32_t offset = 0;
+    resource_load_byte_range(s_locale_handle, sizeof(uint32_t) + id * sizeof(LocaleEntry) + sizeof(uint32_t),
+        (uint8_t *)&offset, sizeof(offset));
+    // The terminating null is within the slot, gen_dict.py checks the length
+    int start = s_strings_offset + offset;
+    int size = MIN(LOCALE_SLOT_BYTES - 1, s_locale_size - start);
+    resource_load_byte_range(s_locale_handle, start, (uint8_t *)s_cache[slot], size);
+    s_cache[slot][LOCALE_SLOT_BYTES - 1] = '\0';
 
-    dict_write_tuplet(&s_locale_dict, &tupl);
+    s_cache_id[slot] = id;
+    s_slot_of[id] = slot;
   }
-
-  dict_write_end(&s_locale_dict);
+  s_cache_used[slot] = ++s_cache_tick;
+  return s_cache[slot];
 }
+#endif
 
-char *locale_str(int hashval) { 
-  Tuple *tupl = dict_find(&s_locale_dict, hashval);
-
-  if (tupl && tupl->value->cstring) {
-    return tupl->value->cstring;
+/*
+ * For hashes computed at runtime
+ */
+#ifdef LOCALE_EAGER
+char *locale_str(int hashval) {
+  // Binary search in the index
+  int lo = 0;
+  int hi = s_locale_entries - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    uint32_t mid_hash = s_locale_index[mid].hashval;
+    if (mid_hash == (uint32_t)hashval) {
+      return (char *)&s_locale_strings[s_locale_index[mid].offset];
+    } else if (mid_hash < (uint32_t)hashval) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
   }
   return "\7"; //return blank character
 }
+#else
+char *locale_str(int hashval) {
+  return locale_str_id(locale_id(hashval));
+}
+#endif
@@ -1,9 +1,27 @@
 #pragma once
 #include "hash.h"
+#include "locale_ids.h"
 
-#define _(str) locale_str(HASH_DJB2(str))
+// Strings are read from the resource on first use and kept in a small
+// LRU cache.
+//
+// Lifetime rule: a string from _() stays valid only until
+// LOCALE_CACHE_SLOTS other strings are looked up. Use it right away, like
+// menu_cell_basic_draw() does, or copy it. Anything that keeps the pointer,
+// a TextLayer above all, gets it through set_label() in ui_util.h. Callers
+// must not rely on LOCALE_EAGER keeping the strings around.
+//
+// Uncomment to load the whole locale at startup.
+//#define LOCALE_EAGER
+
+#define LOCALE_CACHE_SLOTS 12
+// Longest string with its null, gen_dict.py and dict2bin.py check it
+#define LOCALE_SLOT_BYTES 32
+
+// The hash of a literal folds to a constant and locale_id() to the index
+#define _(str) locale_str_id(locale_id(HASH_DJB2(str)))
 
 void locale_init(void);
 
 char *locale_str(int hashval);
-
+char *locale_str_id(int id);
@@ -27,6 +27,9 @@
 #include "comm.h"
 #include "persistence.h"
 #include "localize.h"
+#include "live_window.h"
+#include "trace.h"
+#include "write_account.h"
 
 static uint8_t vib_count;
 static bool alarm_in_motion = NO;
@@ -97,8 +100,7 @@ void persist_read_config() {
     D("Read config with up/down : %d/%d", config.up_coef, config.down_coef);
 }
 
-#ifdef DEBUG
-static char* decode_phase(int a_phase) {
+char* decode_phase(int a_phase) {
     switch (a_phase) {
         case DEEP:
             return _("Deep sleep");
@@ -114,6 +116,7 @@ static char* decode_phase(int a_phase) {
     }
 }
 
+#ifdef DEBUG
 static void dump_current_state() {
     time_t t1 = sleep_data.start_time;
     struct tm *tt = localtime(&t1);
@@ -197,6 +200,7 @@ void decrease_end_min() {
 static void recure_alarm() {
     if (vib_count >= ALARM_MAX_ITERATIONS) {
         alarm_in_motion = NO;
+        trace(TRACE_ALARM_END, config.snooze);
         // Reschedule if no stop alarm and snooze is active
         if (config.snooze > 0) { // This should not be changed in the meanwhile
             snooze_active = YES;
@@ -206,6 +210,8 @@ static void recure_alarm() {
     }
 
     // Vibrate
+    if (vib_count > 0)
+        trace(TRACE_TIMER, TRACE_TIMER_ALARM);
     vibes_long_pulse();
 
     alarm_timer = app_timer_register(ALARM_TIME_BETWEEN_ITERATIONS, recure_alarm, NULL);
@@ -218,6 +224,7 @@ static void recure_alarm() {
 }
 
 void execute_alarm() {
+    trace(TRACE_ALARM_START, 0);
     vib_count = 0;
     alarm_in_motion = YES;
 
@@ -225,6 +232,7 @@ void execute_alarm() {
 }
 
 void snooze_tick() {
+    trace(TRACE_TIMER, TRACE_TIMER_SNOOZE);
     execute_alarm();
 }
 
@@ -260,6 +268,7 @@ void stop_snooze_timer() {
 void ui_click(bool longClick) {
     if (longClick) {
         if (alarm_in_motion) {
+            trace(TRACE_ALARM_STOP, 1);
             stop_alarm_timer();
             stop_snooze_timer();
 
@@ -273,6 +282,7 @@ void ui_click(bool longClick) {
         if (alarm_in_motion) {
             // Check znooze
             if (snooze_active) { // Stop everything - as we have already snoozed
+                trace(TRACE_SNOOZE, config.snooze);
                 stop_alarm_timer();
 
                 // Start snooze timer
@@ -282,12 +292,14 @@ void ui_click(bool longClick) {
                 }
             } else { // activate snooze if set
                 if (config.snooze > 0) {
+                    trace(TRACE_SNOOZE, config.snooze);
                     stop_alarm_timer();
 
                     // Start snooze timer
                     snooze_active = YES;
                     snooze_timer = app_timer_register(config.snooze * 1000 * 60, snooze_tick, NULL);
                 } else {
+                    trace(TRACE_ALARM_STOP, 0);
                     stop_alarm_timer();
                     stop_snooze_timer();
 
@@ -302,7 +314,12 @@ void ui_click(bool longClick) {
     }
 }
 
+static void reset_live_data();
+
 void notify_status_update(int a_status) {
+    trace(TRACE_TRACKING, a_status);
+    // The live view starts over with the night
+    reset_live_data();
     if (a_status == STATUS_ACTIVE) {
         if (config.vibrateOnStatusChange == YES)
             vibes_short_pulse();
@@ -331,7 +348,70 @@ void notify_mode_update(int a_mode) {
 }
 
 void start_motion_capturing() {
-    AppWorkerResult result = app_worker_launch();
+    app_worker_launch();
+}
+
+/*
+ * Running night as the worker reports it, kept in memory only
+ */
+static LiveData live_data;
+
+static void reset_live_data() {
+    memset(&live_data, 0, sizeof(LiveData));
+    refresh_live_window();
+}
+
+static void push_recent(uint8_t value) {
+    if (live_data.recent_count < LIVE_RECENT_MINUTES) {
+        live_data.recent[live_data.recent_count++] = value;
+    } else {
+        memmove(live_data.recent, &live_data.recent[1], LIVE_RECENT_MINUTES - 1);
+        live_data.recent[LIVE_RECENT_MINUTES - 1] = value;
+    }
+}
+
+void update_live_data(uint16_t minute, uint8_t value, uint8_t phase) {
+    if (live_data.valid && minute < live_data.minutes) {
+        // A new night - do not mix it with the last one
+        memset(&live_data, 0, sizeof(LiveData));
+    }
+    if (live_data.valid && minute > live_data.minutes + 1) {
+        // Minutes the app did not get stay empty in the graph
+        int missing = MIN(minute - live_data.minutes - 1, LIVE_RECENT_MINUTES);
+        for (int i = 0; i < missing; i++) {
+            push_recent(LIVE_GAP);
+        }
+    }
+    bool next_minute = !live_data.valid || minute != live_data.minutes;
+    live_data.valid = true;
+    live_data.minutes = minute;
+    live_data.value = value;
+    live_data.phase = phase;
+
+    uint8_t bar = MIN(value, LIVE_GAP - 1);
+    if (!next_minute && live_data.recent_count > 0) {
+        // Snapshot of a minute we already have
+        live_data.recent[live_data.recent_count - 1] = bar;
+    } else {
+        push_recent(bar);
+    }
+    refresh_live_window();
+}
+
+LiveData* read_live_data() {
+    return &live_data;
+}
+
+/*
+ * Tell the worker whether there is an app to hand the minute values to
+ */
+void notify_worker_app_open(bool open) {
+    if (!app_worker_is_running())
+        return;
+    AppWorkerMessage msg_data = {
+        .data0 = 0
+    };
+    app_worker_send_message(open ? APP_CMD_APP_OPEN : APP_CMD_APP_CLOSED, &msg_data);
 }
 
 void stop_motion_capturing() {
@@ -342,7 +422,7 @@ void stop_motion_capturing() {
     // app_worker_send_message(APP_CMD_STOP_CAPTURING, &msg_data);
 
     // Stop the background worker
-    AppWorkerResult result = app_worker_kill();
+    app_worker_kill();
 }
 
 void freeLogic() {
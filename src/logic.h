@@ -69,6 +69,7 @@ void decrease_end_min();
 void accel_data_handler(AccelData *data, uint32_t num_samples);
 void start_motion_capturing();
 void stop_motion_capturing();
+void notify_worker_app_open(bool open);
 
 void ui_click(bool longClick);
 
@@ -82,7 +83,9 @@ void in_received_handler(DictionaryIterator *received, void *context);
 void in_dropped_handler(AppMessageResult reason, void *context);
 
 void set_outbox_size(int outbox_size);
-SleepData* read_last_data();
+void update_live_data(uint16_t minute, uint8_t value, uint8_t phase);
+LiveData* read_live_data();
+char* decode_phase(int a_phase);
 void freeLogic();
 // This should not be here
 void snooze_tick();
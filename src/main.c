@@ -25,10 +25,23 @@
 #include "persistence.h"
 #include "sleep_window.h"
 #include "localize.h"
+#include "comm.h"
+#include "startup.h"
+#include "resource_cache.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "write_account.h"
 
 static void worker_message_handler(uint16_t type, AppWorkerMessage *data) {
     if (type == WORKER_CMD_EXEC_ALARM) {
         execute_alarm();
+    } else if (type == WORKER_CMD_STARTED) {
+        notify_worker_app_open(true);
+    } else if (type == WORKER_CMD_MINUTE_VALUE) {
+        live_minute_value(data->data0, data->data1);
+        update_live_data(data->data0, data->data1, data->data2);
+    } else if (type == WORKER_CMD_LIVE_SNAPSHOT) {
+        update_live_data(data->data0, data->data1, data->data2);
     }
 }
 
@@ -36,12 +49,7 @@ static void focus_handler(bool in_focus) {
     // APP_LOG(APP_LOG_LEVEL_INFO, "App is %s in focus", in_focus ? "now" : "not");
 }
 
-static void handle_init(void) {
-    // Migrate DB
-    migrate_version();
-
-    accel_data_service_subscribe(0, NULL);
-	show_sleep_window();
+static void init_app_message() {
     int inbox_size = app_message_inbox_size_maximum();
     int outbox_size = app_message_outbox_size_maximum();
     app_message_open(inbox_size, outbox_size);
@@ -51,10 +59,36 @@ static void handle_init(void) {
     app_message_register_inbox_dropped(in_dropped_handler);
     app_message_register_outbox_sent(out_sent_handler);
     app_message_register_outbox_failed(out_failed_handler);
+}
 
-    // Subscribe to Worker messages
-    app_worker_message_subscribe(worker_message_handler);
+// Debug bookkeeping reads its keys from flash, so it is deferred too
+static void init_bookkeeping() {
+    diag_load();
+    trace(TRACE_BOOT, 0);
+    write_account_init();
+}
+
+static void init_services() {
+    accel_data_service_subscribe(0, NULL);
     app_focus_service_subscribe(focus_handler);
+    notify_worker_app_open(true);
+}
+
+static void handle_init(void) {
+    // Migrate DB
+    migrate_version();
+    startup_mark("migrate");
+
+    // Subscribe to Worker messages - the worker sends the alarm right after it launched us
+    app_worker_message_subscribe(worker_message_handler);
+
+	show_sleep_window();
+    startup_mark("sleep window");
+
+    // Not needed for the first frame
+    startup_defer(init_bookkeeping, "bookkeeping");
+    startup_defer(init_app_message, "app message");
+    startup_defer(init_services, "services");
 }
 
 static void handle_deinit(void) {
@@ -69,13 +103,24 @@ static void handle_deinit(void) {
     // }
 
     // No more worker updates
+    notify_worker_app_open(false);
     app_worker_message_unsubscribe();
 
     freeLogic();
+    resource_cache_deinit();
+    diag_persist();
+    trace(TRACE_EXIT, 0);
+    trace_persist();
+    write_account_persist();
 }
 
 int main(void) {
+    startup_mark("main");
+    diag_init();
+    // The first window needs its strings, the rest of the reads are deferred
     locale_init();
+    diag_sample(DIAG_LOCALE);
+    startup_mark("locale");
 	handle_init();
 	app_event_loop();
 	handle_deinit();
@@ -26,6 +26,7 @@
 #include "constants.h"
 #include "persistence.h"
 #include "logic.h"
+#include "write_account.h"
 
 int count_motion_values() {
     return persist_read_int(PERSISTENT_COUNT_KEY);
@@ -63,6 +64,34 @@ uint8_t *read_motion_data() {
     return motionVals;
 }
 
+/*
+ * Motion values of the last night reduced to at most width columns, each
+ * the peak of the minutes it covers scaled to 0-height. Reads the values
+ * chunk by chunk, so no heap is needed. Returns the columns filled.
+ */
+int read_motion_columns(uint8_t *columns, int width, int height) {
+    int cntVals = count_motion_values();
+    if (cntVals <= 0 || width <= 0)
+        return 0;
+    int cols = MIN(width, cntVals);
+    memset(columns, 0, cols);
+
+    uint8_t chunk[MAX_PERSIST_BUFFER];
+    for (int start = 0; start < cntVals; start += MAX_PERSIST_BUFFER) {
+        int size = MIN(MAX_PERSIST_BUFFER, cntVals - start);
+        persist_read_data(PERSISTENT_VALUES_KEY + start / MAX_PERSIST_BUFFER, chunk, size);
+        for (int i = 0; i < size; i++) {
+            int col = (start + i) * cols / cntVals;
+            if (chunk[i] > columns[col])
+                columns[col] = chunk[i];
+        }
+    }
+    for (int c = 0; c < cols; c++) {
+        columns[c] = columns[c] * height / 255;
+    }
+    return cols;
+}
+
 StatData* read_last_stat_data() {
     int csd = count_stat_data();
     StatData *stat = malloc(sizeof(StatData));
@@ -99,6 +128,24 @@ StatData** read_stat_data() {
     return stat_data;
 }
 
+/*
+ * All records in one allocation - oldest first
+ */
+StatData* read_stat_data_block(int *count) {
+    int csd = count_stat_data();
+    *count = csd;
+    if (csd <= 0)
+        return NULL;
+
+    StatData *stats = malloc(sizeof(StatData)*csd);
+    if (stats == NULL)
+        return NULL;
+    for (int i = 0; i < csd; i++) {
+        persist_read_data(STAT_START+i, &stats[i], sizeof(StatData));
+    }
+    return stats;
+}
+
 StatData* read_stat_data_rec(int index) {
     StatData *sd = malloc(sizeof(StatData));
     persist_read_data(STAT_START+index, sd, sizeof(StatData));
@@ -109,12 +156,23 @@ StatData* read_stat_data_rec(int index) {
 }
 
 
+/*
+ * Night sequence numbers - the motion values belong to the last night,
+ * stat record i has sequence last - (count - 1 - i)
+ */
+uint32_t read_last_night_seq() {
+    if (persist_exists(NIGHT_SEQ_KEY)) {
+        return persist_read_int(NIGHT_SEQ_KEY);
+    }
+    return count_stat_data();
+}
+
 /*
  * Migrate the DB version
  * Current version is 2
  */
 void migrate_version() {
-    const int current_db_version = 7;
+    const int current_db_version = 8;
     if (!persist_exists(VERSION_KEY)) {
         // In version 1.0 we have 4 values
         if (persist_exists(1))
@@ -166,6 +224,10 @@ void migrate_version() {
             persist_write_config();
             persist_write_int(VERSION_KEY, current_db_version);
         }
+        // Number the nights stored so far
+        if (version < 8 && !persist_exists(NIGHT_SEQ_KEY)) {
+            persist_write_int(NIGHT_SEQ_KEY, count_stat_data());
+        }
     }
 
     // Reset data
@@ -29,9 +29,13 @@
 int count_stat_data();
 StatData** read_stat_data();
 StatData* read_stat_data_rec(int index);
+StatData* read_stat_data_block(int *count);
 StatData* read_last_stat_data();
 int count_motion_values();
 uint8_t *read_motion_data();
+int read_motion_columns(uint8_t *columns, int width, int height);
+
+uint32_t read_last_night_seq();
 
 void migrate_version();
 
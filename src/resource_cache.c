@@ -0,0 +1,115 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+
+#include "resource_cache.h"
+#include "logic.h"
+
+/*
+ * Bitmaps are decoded on the first get and kept after the last release,
+ * so reopening a window does not load them again. They are dropped when
+ * the heap runs out or the app exits.
+ */
+typedef struct {
+    uint32_t resource_id;
+    GBitmap *bitmap;
+    uint8_t refs;
+} CachedBitmap;
+
+static CachedBitmap cache[RESOURCE_CACHE_SLOTS];
+
+static void drop_entry(CachedBitmap *entry) {
+    gbitmap_destroy(entry->bitmap);
+    entry->bitmap = NULL;
+    entry->refs = 0;
+}
+
+GBitmap *resource_cache_get_bitmap(uint32_t resource_id) {
+    CachedBitmap *free_entry = NULL;
+    for (int i = 0; i < RESOURCE_CACHE_SLOTS; i++) {
+        if (cache[i].bitmap == NULL) {
+            if (free_entry == NULL)
+                free_entry = &cache[i];
+        } else if (cache[i].resource_id == resource_id) {
+            cache[i].refs++;
+            return cache[i].bitmap;
+        }
+    }
+
+    if (free_entry == NULL) {
+        resource_cache_trim();
+        for (int i = 0; i < RESOURCE_CACHE_SLOTS && free_entry == NULL; i++) {
+            if (cache[i].bitmap == NULL)
+                free_entry = &cache[i];
+        }
+    }
+
+    GBitmap *bitmap = gbitmap_create_with_resource(resource_id);
+    if (bitmap == NULL) {
+        // Give the unused images back and try once more
+        resource_cache_trim();
+        bitmap = gbitmap_create_with_resource(resource_id);
+    }
+    if (bitmap == NULL) {
+        D("Error loading bitmap %ld", resource_id);
+        return NULL;
+    }
+    if (free_entry == NULL) {
+        // All slots are held - the caller owns this one alone
+        D("Resource cache full, bitmap %ld not shared", resource_id);
+        return bitmap;
+    }
+    free_entry->resource_id = resource_id;
+    free_entry->bitmap = bitmap;
+    free_entry->refs = 1;
+    return bitmap;
+}
+
+void resource_cache_release_bitmap(GBitmap *bitmap) {
+    if (bitmap == NULL)
+        return;
+    for (int i = 0; i < RESOURCE_CACHE_SLOTS; i++) {
+        if (cache[i].bitmap == bitmap) {
+            if (cache[i].refs > 0)
+                cache[i].refs--;
+            return;
+        }
+    }
+    // Not shared, see resource_cache_get_bitmap
+    gbitmap_destroy(bitmap);
+}
+
+void resource_cache_trim() {
+    for (int i = 0; i < RESOURCE_CACHE_SLOTS; i++) {
+        if (cache[i].bitmap != NULL && cache[i].refs == 0)
+            drop_entry(&cache[i]);
+    }
+}
+
+void resource_cache_deinit() {
+    for (int i = 0; i < RESOURCE_CACHE_SLOTS; i++) {
+        if (cache[i].bitmap != NULL)
+            drop_entry(&cache[i]);
+    }
+}
@@ -25,10 +25,19 @@
 #include "logic.h"
 #include "persistence.h"
 #include "localize.h"
+#include "ui_util.h"
+#include "resource_cache.h"
+#include "diagnostics.h"
 
 static int current_index = 0;
 static int count_recs = 0;
+static StatData *stats_block;
+// Shown record, points into stats_block
 static StatData *stats_data;
+// Titles copied out of the string cache, the layers point here
+static char total_title[LOCALE_SLOT_BYTES];
+static char deep_title[LOCALE_SLOT_BYTES];
+static char light_title[LOCALE_SLOT_BYTES];
 
 // BEGIN AUTO-GENERATED UI CODE; DO NOT MODIFY
 static Window *s_window;
@@ -72,9 +81,9 @@ static void initialise_ui(void) {
 #endif
 
     s_res_gothic_18_bold = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
-    s_res_img_arrow_right_black_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_ARROW_RIGHT_BLACK_8X14);
+    s_res_img_arrow_right_black_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_ARROW_RIGHT_BLACK_8X14);
     s_res_roboto_condensed_21 = fonts_get_system_font(FONT_KEY_ROBOTO_CONDENSED_21);
-    s_res_img_arrow_left_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_ARROW_LEFT_8X14);
+    s_res_img_arrow_left_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_ARROW_LEFT_8X14);
     s_res_gothic_24_bold = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
 
     // s_textlayer_dash
@@ -128,19 +137,20 @@ static void initialise_ui(void) {
 
     // s_tl_total
     s_tl_total = text_layer_create(GRect(1+wd, 50+hd, 71, 20));
-    text_layer_set_text(s_tl_total, _("TOTAL:"));
+    total_title[0] = deep_title[0] = light_title[0] = '\0';
+    set_label(s_tl_total, total_title, sizeof(total_title), _("TOTAL:"));
     text_layer_set_font(s_tl_total, s_res_gothic_18_bold);
     layer_add_child(window_get_root_layer(s_window), (Layer *)s_tl_total);
     
     // s_tl_deep
     s_tl_deep = text_layer_create(GRect(1+wd, 76+hd, 71, 20));
-    text_layer_set_text(s_tl_deep, _("Deep:"));
+    set_label(s_tl_deep, deep_title, sizeof(deep_title), _("Deep:"));
     text_layer_set_font(s_tl_deep, s_res_gothic_18_bold);
     layer_add_child(window_get_root_layer(s_window), (Layer *)s_tl_deep);
     
     // s_tl_light
     s_tl_light = text_layer_create(GRect(1+wd, 104+hd, 71, 20));
-    text_layer_set_text(s_tl_light, _("Light:"));
+    set_label(s_tl_light, light_title, sizeof(light_title), _("Light:"));
     text_layer_set_font(s_tl_light, s_res_gothic_18_bold);
     layer_add_child(window_get_root_layer(s_window), (Layer *)s_tl_light);
     
@@ -182,49 +192,114 @@ static void destroy_ui(void) {
     text_layer_destroy(s_tv_total);
     text_layer_destroy(s_tv_deep);
     text_layer_destroy(s_tv_light);
-    gbitmap_destroy(s_res_img_arrow_right_black_8x14);
-    gbitmap_destroy(s_res_img_arrow_left_8x14);
+    resource_cache_release_bitmap(s_res_img_arrow_right_black_8x14);
+    resource_cache_release_bitmap(s_res_img_arrow_left_8x14);
 }
 // END AUTO-GENERATED UI CODE
 
+/*
+ * Motion curve of the last night - the values are reduced once to one
+ * column height per pixel, redraws never read the flash
+ */
+#define GRAPH_MAX_COLUMNS 144
+#define GRAPH_HEIGHT 32
+
+static Layer *s_graph;
+static uint8_t graph_columns[GRAPH_MAX_COLUMNS];
+static int graph_count = 0;
+
+static void graph_draw_frame_buffer(GBitmap *fb, GRect frame) {
+    GBitmapFormat format = gbitmap_get_format(fb);
+    int bottom = frame.origin.y + frame.size.h;
+    for (int y = frame.origin.y; y < bottom; y++) {
+        GBitmapDataRowInfo row = gbitmap_get_data_row_info(fb, y);
+        // Columns reaching up to this row
+        int level = bottom - y;
+        for (int c = 0; c < graph_count; c++) {
+            int x = frame.origin.x + c;
+            if (graph_columns[c] < level || x < row.min_x || x > row.max_x)
+                continue;
+            if (format == GBitmapFormat1Bit) {
+                row.data[x / 8] &= ~(1 << (x % 8));
+            } else {
+                row.data[x] = GColorBlackARGB8;
+            }
+        }
+    }
+}
 
-static void set_stat_light() {
-    uint16_t minutes = stats_data->stat[LIGHT-1];
+static void graph_update_proc(Layer *layer, GContext *ctx) {
+    GRect frame = layer_get_frame(layer);
+    GBitmap *fb = graphics_capture_frame_buffer(ctx);
+    if (fb != NULL) {
+        // The window is fullscreen, the frame is in screen coordinates
+        graph_draw_frame_buffer(fb, frame);
+        graphics_release_frame_buffer(ctx, fb);
+        return;
+    }
+    graphics_context_set_stroke_color(ctx, GColorBlack);
+    for (int c = 0; c < graph_count; c++) {
+        if (graph_columns[c] > 0) {
+            graphics_draw_line(ctx, GPoint(c, frame.size.h - graph_columns[c]), GPoint(c, frame.size.h - 1));
+        }
+    }
+}
+
+static void initialise_graph(void) {
+    Layer *window_layer = window_get_root_layer(s_window);
+    GRect b = layer_get_bounds(window_layer);
+    int width = MIN(b.size.w, GRAPH_MAX_COLUMNS);
+    int height = GRAPH_HEIGHT;
+    int top = b.size.h - height - 2;
+#if defined(PBL_ROUND)
+    // Inside the circle below the values
+    width = 110;
+    height = 22;
+    top = 140;
+#endif
+    s_graph = layer_create(GRect((b.size.w - width) / 2, top, width, height));
+    layer_set_update_proc(s_graph, graph_update_proc);
+    layer_add_child(window_layer, s_graph);
+
+    graph_count = read_motion_columns(graph_columns, width, height);
+}
+
+static void update_graph() {
+    // Only the last night has its motion values stored
+    layer_set_hidden(s_graph, graph_count == 0 || current_index != count_recs - 1);
+}
+
+
+// Texts shown by the value layers
+static char light_lbl[6];
+static char deep_lbl[6];
+static char total_lbl[6];
+static char date_str[8];
+static char from_str[6];
+static char to_str[6];
+
+static void set_duration(TextLayer *layer, char *label, size_t size, uint16_t minutes) {
     int h = (minutes == 0 ? 0 : minutes / 60);
     int m = (minutes == 0 ? 0 : minutes % 60);
-    
-    static char light_lbl[] = "00:00";
-    snprintf(light_lbl, sizeof(light_lbl), "%02d:%02d", h, m);
-    
+
+    char text[6];
+    snprintf(text, sizeof(text), "%02d:%02d", h, m);
+
     D("setLayer: param minutes %d set %02d:%02d", minutes, h, m);
-    
-    text_layer_set_text(s_tv_light, light_lbl);
+
+    set_label(layer, label, size, text);
+}
+
+static void set_stat_light() {
+    set_duration(s_tv_light, light_lbl, sizeof(light_lbl), stats_data->stat[LIGHT-1]);
 }
 
 static void set_stat_deep() {
-    uint16_t minutes = stats_data->stat[DEEP-1];
-    int h = (minutes == 0 ? 0 : minutes / 60);
-    int m = (minutes == 0 ? 0 : minutes % 60);
-    
-    static char deep_lbl[] = "00:00";
-    snprintf(deep_lbl, sizeof(deep_lbl), "%02d:%02d", h, m);
-    
-    D("setLayer: param minutes %d set %02d:%02d", minutes, h, m);
-    
-    text_layer_set_text(s_tv_deep, deep_lbl);
+    set_duration(s_tv_deep, deep_lbl, sizeof(deep_lbl), stats_data->stat[DEEP-1]);
 }
 
 static void set_stat_total() {
-    uint16_t minutes = stats_data->stat[LIGHT-1] + stats_data->stat[DEEP-1];
-    int h = (minutes == 0 ? 0 : minutes / 60);
-    int m = (minutes == 0 ? 0 : minutes % 60);
-    
-    static char total_lbl[] = "00:00";
-    snprintf(total_lbl, sizeof(total_lbl), "%02d:%02d", h, m);
-    
-    D("setLayer: param minutes %d set %02d:%02d", minutes, h, m);
-    
-    text_layer_set_text(s_tv_total, total_lbl);
+    set_duration(s_tv_total, total_lbl, sizeof(total_lbl), stats_data->stat[LIGHT-1] + stats_data->stat[DEEP-1]);
 }
 
 
@@ -246,39 +321,49 @@ static void update_ui_stat_with_sd() {
     set_stat_deep();
     set_stat_total();
     
+    char text[8];
     struct tm *ttd = get_time(&(stats_data->start_time));
-    static char date_str[] = "Xxx 00";
-    strftime(date_str, sizeof(date_str),"%d %b", ttd);
-    text_layer_set_text(s_tl_date, date_str);
+    strftime(text, sizeof(text), "%d %b", ttd);
+    set_label(s_tl_date, date_str, sizeof(date_str), text);
         
-    static char from_str[] = "00:00";
-    strftime(from_str, sizeof(from_str), "%H:%M", ttd);
-    text_layer_set_text(s_tl_from, from_str);
+    strftime(text, sizeof(text), "%H:%M", ttd);
+    set_label(s_tl_from, from_str, sizeof(from_str), text);
     
-    static char to_str[] = "00:00";
     struct tm *tte = get_time(&(stats_data->end_time));
-    strftime(to_str, sizeof(to_str), "%H:%M", tte);
-    text_layer_set_text(s_tl_to, to_str);
-    // D("to: %s", tbufto);
+    strftime(text, sizeof(text), "%H:%M", tte);
+    set_label(s_tl_to, to_str, sizeof(to_str), text);
+
+    update_graph();
 }
 
 static void update_ui_stat_values() {
-    count_recs = count_stat_data();
+    // At most MAX_STAT_COUNT records - read them all once, browsing
+    // only moves within the block
+    free(stats_block);
+    stats_block = read_stat_data_block(&count_recs);
     
     D("Count stats data %d. Update stats with index %d", count_recs, count_recs - 1);
 
-    if (count_recs <= 0) {
+    if (stats_block == NULL) {
+        count_recs = 0;
         hide_sleep_stats();
         return;
     }
+    // The layers are new, show every value once
+    light_lbl[0] = deep_lbl[0] = total_lbl[0] = '\0';
+    date_str[0] = from_str[0] = to_str[0] = '\0';
     current_index = count_recs - 1;
-    stats_data = read_stat_data_rec(current_index);
+    stats_data = &stats_block[current_index];
     update_ui_stat_with_sd();
 }
 
 static void handle_window_unload(Window* window) {
     destroy_ui();
-    free(stats_data);
+    diag_sample(DIAG_STATS_WINDOW);
+    layer_destroy(s_graph);
+    free(stats_block);
+    stats_block = NULL;
+    stats_data = NULL;
 }
 
 static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -289,8 +374,7 @@ static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
     if (current_index > 0) {
         current_index--;
-        free(stats_data);
-        stats_data = read_stat_data_rec(current_index);
+        stats_data = &stats_block[current_index];
         update_ui_stat_with_sd();
     }
 }
@@ -299,8 +383,7 @@ static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
     if (current_index < count_recs - 1) {
         current_index++;
-        free(stats_data);
-        stats_data = read_stat_data_rec(current_index);
+        stats_data = &stats_block[current_index];
         update_ui_stat_with_sd();
     }
 }
@@ -319,6 +402,7 @@ static void config_provider(void *context) {
 
 void show_sleep_stats(void) {
     initialise_ui();
+    initialise_graph();
     window_set_window_handlers(s_window, (WindowHandlers) {
         .unload = handle_window_unload,
     });
@@ -326,6 +410,7 @@ void show_sleep_stats(void) {
     update_ui_stat_values();
 //    light_enable(true);
     window_stack_push(s_window, true);
+    diag_sample(DIAG_STATS_WINDOW);
 }
 
 void hide_sleep_stats(void) {
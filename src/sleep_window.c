@@ -25,7 +25,11 @@
 #include "logic.h"
 #include "alarm_config.h"
 #include "action_menu.h"
+#include "live_window.h"
 #include "localize.h"
+#include "ui_util.h"
+#include "resource_cache.h"
+#include "diagnostics.h"
 
 // First time update date field
 static int forceUpdateDate = YES;
@@ -67,10 +71,11 @@ static void initialise_ui(void) {
 
     s_res_bitham_42_bold = fonts_get_system_font(FONT_KEY_BITHAM_42_BOLD);
     s_res_roboto_condensed_21 = fonts_get_system_font(FONT_KEY_ROBOTO_CONDENSED_21);
-    s_res_img_empty_22x25 = gbitmap_create_with_resource(RESOURCE_ID_IMG_EMPTY_22X25);
-    s_res_img_arrow_right_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_ARROW_RIGHT_8X14);
-    s_res_img_arrow_left_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_ARROW_LEFT_8X14);
-    s_res_img_arrow_right_black_8x14 = gbitmap_create_with_resource(RESOURCE_ID_IMG_ARROW_RIGHT_BLACK_8X14);
+    s_res_img_empty_22x25 = resource_cache_get_bitmap(RESOURCE_ID_IMG_EMPTY_22X25);
+    s_res_img_arrow_right_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_ARROW_RIGHT_8X14);
+    s_res_img_arrow_left_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_ARROW_LEFT_8X14);
+    s_res_img_arrow_right_black_8x14 = resource_cache_get_bitmap(RESOURCE_ID_IMG_ARROW_RIGHT_BLACK_8X14);
+    s_res_img_clock_white_22x25 = resource_cache_get_bitmap(RESOURCE_ID_IMG_CLOCK_WHITE_22X25);
     // s_tl_time
     s_tl_time = text_layer_create(GRect(0, 49, b.size.w, 52));
     text_layer_set_text(s_tl_time, "00:00");
@@ -82,7 +87,7 @@ static void initialise_ui(void) {
     s_tl_status = text_layer_create(GRect(0, 126, b.size.w, 26));
     text_layer_set_background_color(s_tl_status, GColorClear);
     text_layer_set_text_color(s_tl_status, GColorWhite);
-    text_layer_set_text(s_tl_status, _("not tracking"));
+    text_layer_set_text(s_tl_status, "");
     text_layer_set_text_alignment(s_tl_status, GTextAlignmentCenter);
     text_layer_set_font(s_tl_status, s_res_roboto_condensed_21);
     layer_add_child(window_get_root_layer(s_window), (Layer *)s_tl_status);
@@ -113,7 +118,7 @@ static void initialise_ui(void) {
     s_tl_mode = text_layer_create(GRect(1, 21, b.size.w, 28));
     text_layer_set_background_color(s_tl_mode, GColorClear);
     text_layer_set_text_color(s_tl_mode, GColorWhite);
-    text_layer_set_text(s_tl_mode, _("with alarm"));
+    text_layer_set_text(s_tl_mode, "");
     text_layer_set_text_alignment(s_tl_mode, GTextAlignmentCenter);
     text_layer_set_font(s_tl_mode, s_res_roboto_condensed_21);
     layer_add_child(window_get_root_layer(s_window), (Layer *)s_tl_mode);
@@ -168,44 +173,77 @@ static void destroy_ui(void) {
     text_layer_destroy(s_textlayer_1);
 #endif    
 
-    gbitmap_destroy(s_res_img_empty_22x25);
-    gbitmap_destroy(s_res_img_arrow_right_8x14);
-    gbitmap_destroy(s_res_img_arrow_left_8x14);
-    gbitmap_destroy(s_res_img_arrow_right_black_8x14);
-    gbitmap_destroy(s_res_img_clock_white_22x25);
+    resource_cache_release_bitmap(s_res_img_empty_22x25);
+    resource_cache_release_bitmap(s_res_img_arrow_right_8x14);
+    resource_cache_release_bitmap(s_res_img_arrow_left_8x14);
+    resource_cache_release_bitmap(s_res_img_arrow_right_black_8x14);
+    resource_cache_release_bitmap(s_res_img_clock_white_22x25);
 }
 // END AUTO-GENERATED UI CODE
 
+// Texts copied out of the string cache, the layers point here
+static char s_status_text[LOCALE_SLOT_BYTES];
+static char s_wake_text[LOCALE_SLOT_BYTES];
+#if defined(PBL_RECT)
+static char s_mode_text[LOCALE_SLOT_BYTES];
+#endif
+
+static void show_time_text(const char *text) {
+    text_layer_set_text(s_tl_time, text);
+}
+
+static void show_date_text(const char *text) {
+    text_layer_set_text(s_tl_date, text);
+}
+
+static void show_status_text(const char *text) {
+    set_label(s_tl_status, s_status_text, sizeof(s_status_text), text);
+}
+
+static void show_wake_text(const char *text) {
+    set_label(s_textlayer_1, s_wake_text, sizeof(s_wake_text), text);
+}
+
+#if defined(PBL_RECT)
+static void show_mode_text(const char *text) {
+    set_label(s_tl_mode, s_mode_text, sizeof(s_mode_text), text);
+}
+
+static void show_clock(bool show) {
+    bitmap_layer_set_bitmap(s_bm_clock, show ? s_res_img_clock_white_22x25 : s_res_img_empty_22x25);
+}
+#endif
+
 // *********************** Update UI fuctions *********************
 static void update_mode() {
 #if defined(PBL_RECT)       
     if (get_config()->mode == MODE_WEEKEND) {
-        text_layer_set_text(s_tl_mode, _("no alarm"));
-        bitmap_layer_set_bitmap(s_bm_clock, s_res_img_empty_22x25);
-        text_layer_set_text(s_textlayer_1, "");
+        show_mode_text(_("no alarm"));
+        show_clock(false);
+        show_wake_text("");
     } else if (get_config()->mode == MODE_WORKDAY) {
-        text_layer_set_text(s_tl_mode, _("with alarm"));
-        bitmap_layer_set_bitmap(s_bm_clock, s_res_img_clock_white_22x25);
+        show_mode_text(_("with alarm"));
+        show_clock(true);
         static char buffer[] = "00:00 - 00:00";
         snprintf(buffer, sizeof(buffer), "%02d:%02d - %02d:%02d", get_config()->start_wake_hour, get_config()->start_wake_min, get_config()->end_wake_hour, get_config()->end_wake_min);
-        text_layer_set_text(s_textlayer_1, buffer);
+        show_wake_text(buffer);
     }
 #elif defined(PBL_ROUND)   
     if (get_config()->mode == MODE_WEEKEND) {
-        text_layer_set_text(s_textlayer_1, _("no alarm"));
+        show_wake_text(_("no alarm"));
     } else if (get_config()->mode == MODE_WORKDAY) {
         static char buffer[] = "00:00 - 00:00";
         snprintf(buffer, sizeof(buffer), "%02d:%02d - %02d:%02d", get_config()->start_wake_hour, get_config()->start_wake_min, get_config()->end_wake_hour, get_config()->end_wake_min);
-        text_layer_set_text(s_textlayer_1, buffer);
+        show_wake_text(buffer);
     }
 #endif   
 }
 
 static void update_status() {
     if (get_config()->status == STATUS_ACTIVE) {
-        text_layer_set_text(s_tl_status, _("track sleep"));
+        show_status_text(_("track sleep"));
     } else if (get_config()->status == STATUS_NOTACTIVE) {
-        text_layer_set_text(s_tl_status, _("not tracking"));
+        show_status_text(_("not tracking"));
     }
 }
 
@@ -229,11 +267,11 @@ static void update_time() {
 
 
     // Display this time on the TextLayer
-    text_layer_set_text(s_tl_time, buffer);
+    show_time_text(buffer);
     // Update date only when it becomes 00:00
     if ((tick_time->tm_hour == 0 && tick_time->tm_min == 0) || forceUpdateDate ) {
         strftime(bufferDate, sizeof(bufferDate), "%a %d", tick_time);
-        text_layer_set_text(s_tl_date, bufferDate);
+        show_date_text(bufferDate);
         forceUpdateDate = NO;
     }
 }
@@ -265,6 +303,7 @@ static void calculate_mode() {
 // *********************** Window and click handlers ***********************
 static void handle_window_unload(Window* window) {
     destroy_ui();
+    diag_sample(DIAG_SLEEP_WINDOW);
 }
 
 static void handle_window_appear(Window* window) {
@@ -299,6 +338,9 @@ static void up_long_click_release_handler(ClickRecognizerRef recognizer, void *c
 }
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
     //ui_click(NO);
+    if (!is_alarm_running() && get_config()->status == STATUS_ACTIVE) {
+        show_live_window();
+    }
 }
 
 
@@ -371,7 +413,6 @@ static void config_provider(void *context) {
 }
 
 void show_sleep_window(void) {
-    s_res_img_clock_white_22x25 = gbitmap_create_with_resource(RESOURCE_ID_IMG_CLOCK_WHITE_22X25);
     persist_read_config();
     // Check to see if the worker is currently active
     bool worker_is_running = app_worker_is_running();
@@ -381,13 +422,18 @@ void show_sleep_window(void) {
         get_config()->status = STATUS_NOTACTIVE;
     }
 
+#ifdef DEBUG
+    int heap_before = heap_bytes_used();
+#endif
     initialise_ui();
+    D("Sleep window uses %d bytes heap", heap_bytes_used() - heap_before);
 
     window_set_window_handlers(s_window, (WindowHandlers) {
         .unload = handle_window_unload,
         .appear = handle_window_appear
     });
     window_stack_push(s_window, true);
+    diag_sample(DIAG_SLEEP_WINDOW);
     if (forceUpdateDate && !worker_is_running) {
         calculate_mode();
     }
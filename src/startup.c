@@ -0,0 +1,98 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+
+#include "startup.h"
+#include "logic.h"
+
+static StartupMark marks[STARTUP_MAX_MARKS];
+static int mark_count = 0;
+static uint32_t first_ms = 0;
+
+static StartupTask tasks[STARTUP_MAX_TASKS];
+static const char *task_phases[STARTUP_MAX_TASKS];
+static int task_count = 0;
+static int task_next = 0;
+static AppTimer *timerTask;
+
+void startup_mark(const char *phase) {
+    uint32_t now = timestamp_ms();
+    if (mark_count == 0)
+        first_ms = now;
+    if (mark_count >= STARTUP_MAX_MARKS)
+        return;
+    marks[mark_count].phase = phase;
+    marks[mark_count].ms = now - first_ms;
+    mark_count++;
+}
+
+/*
+ * One task per timer, so the event loop gets its turn between them
+ */
+static void task_timer_callback() {
+    if (task_next == 0) {
+        // The event loop is up - the SDK has no hook for the first render,
+        // so this is the closest mark to it
+        startup_mark("event loop");
+    }
+    StartupTask task = tasks[task_next];
+    const char *phase = task_phases[task_next];
+    task_next++;
+    task();
+    startup_mark(phase);
+
+    if (task_next < task_count) {
+        timerTask = app_timer_register(0, task_timer_callback, NULL);
+    } else {
+        startup_dump();
+    }
+}
+
+void startup_defer(StartupTask task, const char *phase) {
+    if (task_count >= STARTUP_MAX_TASKS) {
+        // No room - run it now rather than never
+        task();
+        startup_mark(phase);
+        return;
+    }
+    tasks[task_count] = task;
+    task_phases[task_count] = phase;
+    task_count++;
+    if (task_count == 1)
+        timerTask = app_timer_register(0, task_timer_callback, NULL);
+}
+
+int startup_mark_count() {
+    return mark_count;
+}
+
+const StartupMark *startup_marks() {
+    return marks;
+}
+
+void startup_dump() {
+    for (int i = 0; i < mark_count; i++) {
+        D("Startup %4d ms %s", marks[i].ms, marks[i].phase);
+    }
+}
@@ -0,0 +1,48 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PebSlee_startup_h
+#define PebSlee_startup_h
+
+#include <pebble.h>
+
+#define STARTUP_MAX_MARKS 12
+#define STARTUP_MAX_TASKS 6
+
+typedef void (*StartupTask)(void);
+
+typedef struct {
+    const char *phase;
+    uint16_t ms;            // since the first mark
+} StartupMark;
+
+// Records the time the phase ended
+void startup_mark(const char *phase);
+// Runs the task from the event loop, after handle_init() returned
+void startup_defer(StartupTask task, const char *phase);
+
+int startup_mark_count();
+const StartupMark *startup_marks();
+void startup_dump();
+
+#endif
@@ -0,0 +1,62 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "sync_codec.h"
+
+static int write_varint(uint32_t value, uint8_t *out, int pos, int out_size) {
+    do {
+        if (pos >= out_size)
+            return -1;
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        if (value)
+            b |= 0x80;
+        out[pos++] = b;
+    } while (value);
+    return pos;
+}
+
+int sync_encode_delta_rle(const uint8_t *values, int count, uint8_t *out, int out_size) {
+    int pos = 0;
+    int prev = 0;
+    int i = 0;
+    while (i < count && pos >= 0) {
+        int delta = values[i] - prev;
+        if (delta == 0) {
+            int run = 0;
+            while (i < count && values[i] == prev) {
+                run++;
+                i++;
+            }
+            pos = write_varint(0, out, pos, out_size);
+            if (pos >= 0)
+                pos = write_varint(run, out, pos, out_size);
+        } else {
+            uint32_t zigzag = (uint32_t)((delta << 1) ^ (delta >> 31));
+            pos = write_varint(zigzag, out, pos, out_size);
+            prev = values[i];
+            i++;
+        }
+    }
+    return pos;
+}
@@ -0,0 +1,39 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef PebSlee_sync_codec_h
+#define PebSlee_sync_codec_h
+
+#include <stdint.h>
+
+// Worst case size of an encoded stream for count values
+#define SYNC_CODEC_MAX_SIZE(count) (2 * (count) + 3)
+
+// Delta + run-length + varint encoding of the motion values.
+// Every value is written as the zig-zagged difference to the previous one
+// (the first one is compared to 0) in LEB128 varint form. A zero difference
+// is never written on its own - a 0 byte is followed by a varint with the
+// number of repeated values instead.
+// Returns the number of bytes written or -1 if out is too small.
+int sync_encode_delta_rle(const uint8_t *values, int count, uint8_t *out, int out_size);
+
+#endif
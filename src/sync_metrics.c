@@ -0,0 +1,122 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <pebble.h>
+
+#include "sync_metrics.h"
+#include "logic.h"
+#include "write_account.h"
+
+static const uint16_t latency_limits[SYNC_LATENCY_BUCKETS - 1] = { 50, 100, 200, 500, 1000 };
+
+static SyncSummary current;
+static SyncSummary last;
+static bool last_loaded = false;
+
+static uint32_t requested_ms = 0;
+static uint32_t started_ms = 0;
+
+/*
+ * The phone asked - time to first byte counts from here
+ */
+void sync_metrics_requested() {
+    requested_ms = timestamp_ms();
+}
+
+void sync_metrics_start() {
+    // Drops before the sync are counted too
+    uint16_t dropped = current.dropped_inbound;
+    memset(&current, 0, sizeof(current));
+    current.dropped_inbound = dropped;
+    started_ms = timestamp_ms();
+}
+
+void sync_metrics_sent(uint32_t ack_ms, uint16_t bytes) {
+    if (current.messages == 0) {
+        current.first_byte_ms = timestamp_ms() - requested_ms;
+    }
+    current.messages++;
+    current.bytes += bytes;
+
+    int bucket = 0;
+    while (bucket < SYNC_LATENCY_BUCKETS - 1 && ack_ms >= latency_limits[bucket]) {
+        bucket++;
+    }
+    current.ack_latency[bucket]++;
+
+    uint32_t elapsed = timestamp_ms() - started_ms;
+    if (elapsed > 0) {
+        current.bytes_per_sec = (current.bytes * 1000) / elapsed;
+    }
+}
+
+void sync_metrics_failed(AppMessageResult reason, int chunk_retries) {
+    current.retries++;
+    if (reason == APP_MSG_BUSY) {
+        current.busy++;
+    } else if (reason == APP_MSG_SEND_TIMEOUT) {
+        current.timeouts++;
+    }
+    if (chunk_retries > current.max_chunk_retries) {
+        current.max_chunk_retries = chunk_retries;
+    }
+}
+
+void sync_metrics_dropped() {
+    current.dropped_inbound++;
+}
+
+/*
+ * Keep the summary of the sync in RAM and on flash for later
+ */
+void sync_metrics_finish(bool completed, uint16_t chunk_bytes) {
+    current.finished = time(NULL);
+    current.duration_ms = timestamp_ms() - started_ms;
+    current.chunk_bytes = chunk_bytes;
+    current.completed = completed;
+
+    D("Sync: %ld bytes in %ld ms, %ld bytes/s, first byte %d ms, %d retries",
+      current.bytes, current.duration_ms, current.bytes_per_sec, current.first_byte_ms, current.retries);
+
+    last = current;
+    last_loaded = true;
+    persist_write_data(SYNC_SUMMARY_KEY, &last, sizeof(last));
+
+    current.dropped_inbound = 0;
+}
+
+const SyncSummary *sync_metrics_current() {
+    return &current;
+}
+
+const SyncSummary *sync_metrics_last() {
+    if (!last_loaded) {
+        if (persist_exists(SYNC_SUMMARY_KEY)) {
+            persist_read_data(SYNC_SUMMARY_KEY, &last, sizeof(last));
+        } else {
+            memset(&last, 0, sizeof(last));
+        }
+        last_loaded = true;
+    }
+    return &last;
+}
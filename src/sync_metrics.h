@@ -0,0 +1,59 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PebSlee_sync_metrics_h
+#define PebSlee_sync_metrics_h
+
+#include <pebble.h>
+
+// Ack latency buckets: <50, <100, <200, <500, <1000, >=1000 ms
+#define SYNC_LATENCY_BUCKETS 6
+
+typedef struct {
+    uint32_t finished;          // time the sync ended
+    uint32_t duration_ms;
+    uint32_t bytes;             // acked bytes on air
+    uint32_t bytes_per_sec;
+    uint16_t first_byte_ms;     // from the phone request to the first ack
+    uint16_t chunk_bytes;       // message size the controller settled on
+    uint16_t messages;
+    uint16_t retries;           // failed sends
+    uint16_t busy;              // ...of them with APP_MSG_BUSY
+    uint16_t timeouts;          // ...of them with APP_MSG_SEND_TIMEOUT
+    uint16_t max_chunk_retries; // most retries of a single message
+    uint16_t dropped_inbound;
+    uint16_t ack_latency[SYNC_LATENCY_BUCKETS];
+    uint8_t completed;
+} SyncSummary;
+
+void sync_metrics_requested();
+void sync_metrics_start();
+void sync_metrics_sent(uint32_t ack_ms, uint16_t bytes);
+void sync_metrics_failed(AppMessageResult reason, int chunk_retries);
+void sync_metrics_dropped();
+void sync_metrics_finish(bool completed, uint16_t chunk_bytes);
+
+const SyncSummary *sync_metrics_current();
+const SyncSummary *sync_metrics_last();
+
+#endif
@@ -26,6 +26,7 @@
 #include "syncprogress_window.h"
 #include "localize.h"
 #include "logic.h"
+#include "diagnostics.h"
 
 // BEGIN AUTO-GENERATED UI CODE; DO NOT MODIFY
 static Window *s_window;
@@ -71,6 +72,7 @@ static void destroy_ui(void) {
 
 static void handle_window_unload(Window* window) {
     destroy_ui();
+    diag_sample(DIAG_SYNC_WINDOW);
 }
 
 void show_syncprogress_window(void) {
@@ -79,6 +81,7 @@ void show_syncprogress_window(void) {
         .unload = handle_window_unload,
     });
     window_stack_push(s_window, true);
+    diag_sample(DIAG_SYNC_WINDOW);
 }
 
 void hide_syncprogress_window(void) {
@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef PebSlee_trace_h
+#define PebSlee_trace_h
+
+/*
+ * Binary event trace of the app and the worker - 4 bytes per event,
+ * kept in RAM, persisted on exit and exported on request.
+ * trace_decode.py prints it as a timeline.
+ *
+ * Included by the app and the worker, so it relies on the includer for
+ * the SDK header.
+ */
+#define TRACE_EVENTS 60
+// Unit of TraceEvent.delta
+#define TRACE_TICK_MS 100
+
+typedef struct {
+    uint8_t id;
+    uint8_t delta;          // TRACE_TICK_MS since the previous event
+    uint16_t arg;
+} TraceEvent;
+
+typedef struct {
+    uint32_t newest_time;   // of the newest event, the others are back from it
+    uint16_t newest_ms;
+    uint8_t count;
+    uint8_t head;           // slot of the next event
+    TraceEvent events[TRACE_EVENTS];
+} TraceRing;
+
+// Event ids - keep trace_decode.py in sync
+#define TRACE_BOOT 1            // arg: 0 app, 1 worker
+#define TRACE_GAP 2             // arg: seconds without events, the next one has delta 0
+#define TRACE_TIMER 3           // arg: TRACE_TIMER_*
+#define TRACE_PHASE 4           // arg: new SleepPhases
+#define TRACE_ALARM_CHECK 5     // arg: TRACE_ALARM_* << 8 | phase
+#define TRACE_ALARM_START 6
+#define TRACE_ALARM_END 7       // arg: snooze minutes, 0 when it just stops
+#define TRACE_SNOOZE 8          // arg: minutes
+#define TRACE_ALARM_STOP 9      // arg: 1 long click
+#define TRACE_TRACKING 10       // arg: STATUS_*
+#define TRACE_STORE 11          // arg: minutes stored
+#define TRACE_SYNC_START 12     // arg: command
+#define TRACE_SYNC_NIGHT 13     // arg: night sequence
+#define TRACE_SYNC_END 14       // arg: 1 completed
+#define TRACE_EXIT 15           // arg: 0 app, 1 worker
+
+#define TRACE_TIMER_ALARM 1
+#define TRACE_TIMER_SNOOZE 2
+
+#define TRACE_ALARM_WAIT 0      // in the window, not light sleep yet
+#define TRACE_ALARM_LIGHT 1     // light sleep in the window
+#define TRACE_ALARM_DEADLINE 2  // end of the window
+
+// The ring persisted under TRACE_KEY is continued from the first event
+void trace(uint8_t id, uint16_t arg);
+// Writes the ring if something besides boot and exit was traced
+void trace_persist();
+const TraceRing *trace_ring();
+
+#endif
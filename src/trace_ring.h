@@ -0,0 +1,91 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/*
+ * Implementation of trace.h, compiled into the app by trace.c and into
+ * the worker by worker_src/worker_trace.c, each defining TRACE_KEY
+ */
+static TraceRing ring;
+static bool ring_loaded = false;
+static bool ring_dirty = false;
+
+// Continues the persisted ring - read on the first event, not at startup
+static void trace_load() {
+    if (ring_loaded)
+        return;
+    ring_loaded = true;
+    if (persist_read_data(TRACE_KEY, &ring, sizeof(TraceRing)) != sizeof(TraceRing)
+        || ring.head >= TRACE_EVENTS || ring.count > TRACE_EVENTS) {
+        memset(&ring, 0, sizeof(TraceRing));
+    }
+}
+
+static void trace_push(uint8_t id, uint8_t delta, uint16_t arg) {
+    TraceEvent *event = &ring.events[ring.head];
+    event->id = id;
+    event->delta = delta;
+    event->arg = arg;
+    ring.head = (ring.head + 1) % TRACE_EVENTS;
+    if (ring.count < TRACE_EVENTS)
+        ring.count++;
+}
+
+void trace(uint8_t id, uint16_t arg) {
+    time_t sec;
+    uint16_t ms;
+    time_ms(&sec, &ms);
+    trace_load();
+
+    uint8_t delta = 0;
+    if (ring.count > 0) {
+        uint32_t diff_s = (uint32_t)sec - ring.newest_time;
+        if ((uint32_t)sec < ring.newest_time) {
+            // Clock set back
+            diff_s = 0;
+        }
+        if (diff_s >= 255 * TRACE_TICK_MS / 1000) {
+            trace_push(TRACE_GAP, 0, diff_s > UINT16_MAX ? UINT16_MAX : diff_s);
+        } else {
+            int diff_ms = diff_s * 1000 + ms - ring.newest_ms;
+            delta = diff_ms < 0 ? 0 : diff_ms / TRACE_TICK_MS;
+        }
+    }
+    ring.newest_time = sec;
+    ring.newest_ms = ms;
+    trace_push(id, delta, arg);
+    // Boot and exit alone are not worth a write - they go with the next event
+    if (id != TRACE_BOOT && id != TRACE_EXIT)
+        ring_dirty = true;
+}
+
+void trace_persist() {
+    if (!ring_dirty)
+        return;
+    persist_write_data(TRACE_KEY, &ring, sizeof(TraceRing));
+    ring_dirty = false;
+}
+
+const TraceRing *trace_ring() {
+    trace_load();
+    return &ring;
+}
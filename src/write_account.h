@@ -0,0 +1,75 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#ifndef PebSlee_write_account_h
+#define PebSlee_write_account_h
+
+/*
+ * Flash write accounting of a debug build. With WRITE_ACCOUNTING every
+ * persist_write_* of the files including this header is counted: logical
+ * bytes, bytes that really changed, rewrites of the same data and a heat
+ * map of the keys. The app and the worker keep an account each, shown on
+ * the diagnostics page.
+ *
+ * Each write reads the key first to compare, so it is not for releases.
+ * Included by the app and the worker, after the SDK header.
+ */
+//#define WRITE_ACCOUNTING
+
+#define WRITE_ACCOUNT_SLOTS 28
+// Slot of the keys that did not get their own
+#define WRITE_ACCOUNT_OTHER 0xFF
+
+typedef struct {
+    uint32_t writes;
+    uint32_t bytes;             // as passed to persist_write_*
+    uint32_t changed_bytes;     // that differ from what the key held
+    uint16_t unchanged;         // writes of the same data again
+    uint8_t slots_used;
+    uint8_t runs;
+    uint8_t key[WRITE_ACCOUNT_SLOTS];
+    uint16_t key_writes[WRITE_ACCOUNT_SLOTS];
+    uint32_t key_bytes[WRITE_ACCOUNT_SLOTS];
+} WriteAccount;
+
+#ifdef WRITE_ACCOUNTING
+// Counts a run - the account under WRITE_ACCOUNT_KEY is read on first use
+void write_account_init();
+void write_account_persist();
+// Clears the accounts of the app and the worker
+void write_account_reset();
+const WriteAccount *write_account();
+
+int write_account_data(const uint32_t key, const void *data, const size_t size);
+status_t write_account_int(const uint32_t key, const int32_t value);
+
+#define persist_write_data(key, data, size) write_account_data(key, data, size)
+#define persist_write_int(key, value) write_account_int(key, value)
+#else
+#define write_account_init()
+#define write_account_persist()
+#define write_account_reset()
+#endif
+
+#endif
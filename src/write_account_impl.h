@@ -0,0 +1,124 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2014 Nick Penkov <nick at npenkov dot org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+/*
+ * Implementation of write_account.h, compiled into the app by
+ * write_account.c and into the worker by worker_src/worker_write_account.c,
+ * each defining WRITE_ACCOUNT_KEY
+ */
+#ifdef WRITE_ACCOUNTING
+
+// The account writes itself past the counting
+#undef persist_write_data
+#undef persist_write_int
+
+static WriteAccount account;
+static bool account_loaded = false;
+static bool account_dirty = false;
+
+// Continues the persisted account - read on the first write or run, not at startup
+static void account_load() {
+    if (account_loaded)
+        return;
+    account_loaded = true;
+    if (persist_read_data(WRITE_ACCOUNT_KEY, &account, sizeof(WriteAccount)) != sizeof(WriteAccount)
+        || account.slots_used > WRITE_ACCOUNT_SLOTS) {
+        memset(&account, 0, sizeof(WriteAccount));
+    }
+}
+
+static int account_slot(uint32_t key) {
+    uint8_t id = key < WRITE_ACCOUNT_OTHER ? key : WRITE_ACCOUNT_OTHER;
+    for (int i = 0; i < account.slots_used; i++) {
+        if (account.key[i] == id)
+            return i;
+    }
+    // The last slot is kept for the rest
+    if (account.slots_used >= WRITE_ACCOUNT_SLOTS - 1 && id != WRITE_ACCOUNT_OTHER)
+        return account_slot(WRITE_ACCOUNT_OTHER);
+    account.key[account.slots_used] = id;
+    return account.slots_used++;
+}
+
+static void account_write(uint32_t key, const void *data, size_t size) {
+    account_load();
+    uint8_t old[PERSIST_DATA_MAX_LENGTH];
+    int old_size = persist_read_data(key, old, sizeof(old));
+    if (old_size < 0)
+        old_size = 0;
+    const uint8_t *bytes = data;
+    uint32_t changed = 0;
+    for (size_t i = 0; i < size; i++) {
+        if ((int)i >= old_size || old[i] != bytes[i])
+            changed++;
+    }
+
+    account.writes++;
+    account.bytes += size;
+    account.changed_bytes += changed;
+    if (changed == 0 && old_size == (int)size)
+        account.unchanged++;
+    int slot = account_slot(key);
+    account.key_writes[slot]++;
+    account.key_bytes[slot] += size;
+    account_dirty = true;
+}
+
+int write_account_data(const uint32_t key, const void *data, const size_t size) {
+    account_write(key, data, size);
+    return persist_write_data(key, data, size);
+}
+
+status_t write_account_int(const uint32_t key, const int32_t value) {
+    account_write(key, &value, sizeof(value));
+    return persist_write_int(key, value);
+}
+
+void write_account_init() {
+    account_load();
+    account.runs++;
+    account_dirty = true;
+}
+
+void write_account_persist() {
+    if (!account_dirty)
+        return;
+    persist_write_data(WRITE_ACCOUNT_KEY, &account, sizeof(WriteAccount));
+    account_dirty = false;
+}
+
+void write_account_reset() {
+    memset(&account, 0, sizeof(WriteAccount));
+    account_loaded = true;
+    account_dirty = true;
+    persist_delete(WRITE_ACCOUNT_APP_KEY);
+    persist_delete(WRITE_ACCOUNT_WORKER_KEY);
+}
+
+const WriteAccount *write_account() {
+    account_load();
+    return &account;
+}
+
+#endif
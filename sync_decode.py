@@ -0,0 +1,118 @@
+#!/usr/bin/python
+import sys
+import struct
+
+# Encodings negotiated with PS_APP_TO_WATCH_SYNC_ENCODING (see constants.h)
+ENCODING_RAW = 0
+ENCODING_DELTA_RLE = 1
+
+
+def read_varint(data, pos):
+    """read a LEB128 varint
+    Args:
+        data (bytearray): encoded stream
+        pos (int): position of the first byte
+    Returns:
+        (int, int): the value and the position after it
+    """
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("truncated varint at %d" % pos)
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def write_varint(value, out):
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return
+
+
+def decode_delta_rle(data):
+    """reference decoder of sync_encode_delta_rle() in src/sync_codec.c
+    Args:
+        data (bytearray): encoded motion values
+    Returns:
+        (list): the motion values 0-255
+    """
+    values = []
+    prev = 0
+    pos = 0
+    while pos < len(data):
+        token, pos = read_varint(data, pos)
+        if token == 0:
+            run, pos = read_varint(data, pos)
+            values.extend([prev] * run)
+        else:
+            delta = (token >> 1) ^ -(token & 1)
+            prev += delta
+            if prev < 0 or prev > 255:
+                raise ValueError("value out of range at %d" % pos)
+            values.append(prev)
+    return values
+
+
+def encode_delta_rle(values):
+    """same encoding as the watch, used to estimate payload size of a night"""
+    out = bytearray()
+    prev = 0
+    i = 0
+    while i < len(values):
+        if values[i] == prev:
+            run = 0
+            while i < len(values) and values[i] == prev:
+                run += 1
+                i += 1
+            out.append(0)
+            write_varint(run, out)
+        else:
+            delta = values[i] - prev
+            write_varint((delta << 1) ^ (delta >> 31), out)
+            prev = values[i]
+            i += 1
+    return out
+
+
+def raw_bytes_on_air(count):
+    # 1 byte tuple count + 7 byte tuple header and 1 byte value per tuple
+    return 1 + 8 * count
+
+
+def main():
+    if len(sys.argv) - 1 != 2 or sys.argv[1] not in ("decode", "encode"):
+        print("********************")
+        print("Usage suggestion:")
+        print("python " + sys.argv[0] + " decode <payload.bin>")
+        print("python " + sys.argv[0] + " encode <values.bin>")
+        print("********************")
+        exit()
+
+    data = bytearray(open(sys.argv[2], 'rb').read())
+    if sys.argv[1] == "decode":
+        values = decode_delta_rle(data)
+        encoded = data
+        print(" ".join(str(v) for v in values))
+    else:
+        values = list(data)
+        encoded = encode_delta_rle(values)
+        if decode_delta_rle(encoded) != values:
+            raise ValueError("round trip failed")
+
+    print("%d values, %d bytes raw on air, %d bytes encoded (%.1f%%)" % (
+        len(values), raw_bytes_on_air(len(values)), len(encoded),
+        100.0 * len(encoded) / max(1, raw_bytes_on_air(len(values)))))
+
+
+if __name__ == '__main__':
+    main()
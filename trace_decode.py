@@ -0,0 +1,100 @@
+#!/usr/bin/python
+import sys
+import struct
+import time
+
+# TraceRing of src/trace.h - little endian, 60 events of 4 bytes
+TRACE_EVENTS = 60
+TRACE_TICK_MS = 100
+RING_HEADER = "<IHBB"
+RING_SIZE = struct.calcsize(RING_HEADER) + 4 * TRACE_EVENTS
+
+TRACE_GAP = 2
+EVENT_NAMES = {
+    1: "boot",
+    2: "gap",
+    3: "timer",
+    4: "phase",
+    5: "alarm check",
+    6: "alarm start",
+    7: "alarm end",
+    8: "snooze",
+    9: "alarm stop",
+    10: "tracking",
+    11: "store",
+    12: "sync start",
+    13: "sync night",
+    14: "sync end",
+    15: "exit",
+}
+PHASES = {1: "deep", 2: "rem", 3: "light", 4: "awake"}
+TIMERS = {1: "alarm", 2: "snooze"}
+ALARM_DECISIONS = {0: "wait", 1: "light sleep", 2: "deadline"}
+
+
+def describe(event_id, arg):
+    if event_id == 3:
+        return TIMERS.get(arg, str(arg))
+    if event_id == 4:
+        return PHASES.get(arg, str(arg))
+    if event_id == 5:
+        return "%s in %s" % (ALARM_DECISIONS.get(arg >> 8, str(arg >> 8)),
+                             PHASES.get(arg & 0xFF, str(arg & 0xFF)))
+    if event_id == 10:
+        return "on" if arg else "off"
+    return str(arg)
+
+
+def decode_ring(data, source):
+    """events of one ring, oldest first
+    Args:
+        data (bytearray): TraceRing as persisted or sent
+        source (str): label of the ring
+    Returns:
+        (list): (time in ms, source, id, arg) tuples
+    """
+    if len(data) < RING_SIZE:
+        raise ValueError("%s: %d bytes, a ring has %d" % (source, len(data), RING_SIZE))
+    newest_time, newest_ms, count, head = struct.unpack_from(RING_HEADER, data, 0)
+    if count > TRACE_EVENTS or head >= TRACE_EVENTS:
+        raise ValueError("%s: broken ring header" % source)
+
+    # Walk back from the newest event
+    events = []
+    at = newest_time * 1000 + newest_ms
+    for i in range(count):
+        slot = (head - 1 - i) % TRACE_EVENTS
+        event_id, delta, arg = struct.unpack_from("<BBH", data, struct.calcsize(RING_HEADER) + 4 * slot)
+        events.append((at, source, event_id, arg))
+        at -= delta * TRACE_TICK_MS
+        if event_id == TRACE_GAP:
+            at -= arg * 1000
+    events.reverse()
+    return events
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("********************")
+        print("Usage suggestion:")
+        print("python " + sys.argv[0] + " <app_ring.bin> [<worker_ring.bin>]")
+        print("********************")
+        exit()
+
+    events = []
+    for index, path in enumerate(sys.argv[1:]):
+        source = "app" if index == 0 else "worker"
+        events.extend(decode_ring(bytearray(open(path, 'rb').read()), source))
+    events.sort(key=lambda e: e[0])
+
+    for at, source, event_id, arg in events:
+        if event_id == TRACE_GAP:
+            continue
+        stamp = time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(at // 1000))
+        print("%s.%d %-6s %-12s %s" % (stamp, (at % 1000) // 100, source,
+                                       EVENT_NAMES.get(event_id, "#%d" % event_id),
+                                       describe(event_id, arg)))
+
+
+if __name__ == '__main__':
+    main()
@@ -22,6 +22,8 @@
 
 #include <pebble_worker.h>
 #include "constants.h"
+#include "trace.h"
+#include "write_account.h"
 
 static GlobalConfig config;
 static AppTimer *timer;
@@ -34,6 +36,13 @@ static bool snooze_active = NO;
 
 static uint16_t motion_peek_in_min = 0;
 
+// Foreground app is open and takes the minute values
+static bool app_open = NO;
+static uint16_t last_sent_count = 0;
+
+// Counted cheaply all night, stored with the night
+static WorkerCounters counters;
+
 const int ALARM_TIME_BETWEEN_ITERATIONS = 5000; // 5 sec
 const int ALARM_MAX_ITERATIONS = 10; // Vibrate max 10 times
 
@@ -61,15 +70,56 @@ const int REPORTING_STEP_MS = 20000;
 static int thresholds[COUNT_TRESHOLDS] = { 0, DEEP_SLEEP_THRESHOLD, REM_SLEEP_THRESHOLD, LIGHT_THRESHOLD, 65535 };
 const uint8_t LAST_MIN_WAKE = 2;
 
+/*
+ * Flash access of the worker goes through these, so it is counted
+ */
+static int32_t read_int(const uint32_t key) {
+    counters.persist_reads++;
+    return persist_read_int(key);
+}
+
+static int read_data(const uint32_t key, void *buffer, const size_t size) {
+    counters.persist_reads++;
+    return persist_read_data(key, buffer, size);
+}
+
+static void write_int(const uint32_t key, const int32_t value) {
+    counters.persist_writes++;
+    persist_write_int(key, value);
+}
+
+static void write_data(const uint32_t key, const void *data, const size_t size) {
+    counters.persist_writes++;
+    persist_write_data(key, data, size);
+}
+
 int count_stat_data() {
     if (persist_exists(COUNT_STATS_KEY)) {
-        return persist_read_int(COUNT_STATS_KEY);
+        return read_int(COUNT_STATS_KEY);
     } else {
-        persist_write_int(COUNT_STATS_KEY, 0);
+        write_int(COUNT_STATS_KEY, 0);
         return 0;
     }
 }
 
+/*
+ * Heap high-water marks of the worker, written with the night
+ */
+static void sample_worker_heap() {
+    WorkerDiag diag = { 0, UINT16_MAX };
+    if (persist_exists(WORKER_DIAG_KEY))
+        read_data(WORKER_DIAG_KEY, &diag, sizeof(WorkerDiag));
+    int used = heap_bytes_used();
+    int free_bytes = heap_bytes_free();
+    if (used <= diag.heap_peak && free_bytes >= diag.heap_min_free)
+        return;
+    if (used > diag.heap_peak)
+        diag.heap_peak = used;
+    if (free_bytes < diag.heap_min_free)
+        diag.heap_min_free = free_bytes;
+    write_data(WORKER_DIAG_KEY, &diag, sizeof(WorkerDiag));
+}
+
 void store_data(SleepData* data) {
 
     // Prevent storing empty sleep data less than 5 min
@@ -77,7 +127,7 @@ void store_data(SleepData* data) {
         return;
 
     // Store first the values
-    persist_write_int(PERSISTENT_COUNT_KEY, data->count_values);
+    write_int(PERSISTENT_COUNT_KEY, data->count_values);
     // Transform values from 0->5000 to 0-255 scale
     uint8_t *values = malloc(sizeof(uint8_t) * data->count_values);
     for (int i = 0; i < data->count_values; i++) {
@@ -97,7 +147,7 @@ void store_data(SleepData* data) {
                 size = data->count_values % MAX_PERSIST_BUFFER;
             }
         }
-        persist_write_data(PERSISTENT_VALUES_KEY+i, &values[i*MAX_PERSIST_BUFFER], size);
+        write_data(PERSISTENT_VALUES_KEY+i, &values[i*MAX_PERSIST_BUFFER], size);
     }
     free(values);
 
@@ -114,28 +164,39 @@ void store_data(SleepData* data) {
     StatData **stat_data = malloc(sizeof(StatData*)*csd);
     for (int i = 0; i < csd; i++) {
         StatData *sd = malloc(sizeof(StatData));
-        persist_read_data(STAT_START+i, sd, sizeof(StatData));
+        read_data(STAT_START+i, sd, sizeof(StatData));
         stat_data[i] = sd;
     }
+    // All the records are loaded - the most the worker ever holds
+    sample_worker_heap();
 
     if (csd < MAX_STAT_COUNT) {
         // Just add one more at the end
-        persist_write_data(STAT_START + csd, new_stat, sizeof(StatData));
-        persist_write_int(COUNT_STATS_KEY, csd + 1);
+        write_data(STAT_START + csd, new_stat, sizeof(StatData));
+        write_int(COUNT_STATS_KEY, csd + 1);
     } else {
         // Write from 1..MAX_STAT_COUNT
         for (int i = 0; i < MAX_STAT_COUNT - 1; i++) {
-            persist_write_data(STAT_START + i, stat_data[i+1], sizeof(StatData));
+            write_data(STAT_START + i, stat_data[i+1], sizeof(StatData));
         }
         // ...and the newest one
-        persist_write_data(STAT_START + csd - 1, new_stat, sizeof(StatData));
-        persist_write_int(COUNT_STATS_KEY, csd);
+        write_data(STAT_START + csd - 1, new_stat, sizeof(StatData));
+        write_int(COUNT_STATS_KEY, csd);
     }
     for (int i = 0; i < csd; i++) {
         free(stat_data[i]);
     }
     free(stat_data);
     free(new_stat);
+
+    // Number the night, so the phone can ask only for the new ones
+    uint32_t seq = persist_exists(NIGHT_SEQ_KEY) ? read_int(NIGHT_SEQ_KEY) : csd;
+    write_int(NIGHT_SEQ_KEY, seq + 1);
+
+    // Counters belong to the night just stored, like the motion values
+    write_data(WORKER_COUNTERS_KEY, &counters, sizeof(WorkerCounters));
+
+    trace(TRACE_STORE, data->count_values);
 }
 
 void stop_sleep_data_capturing() {
@@ -163,6 +224,19 @@ void main_app_exec_alarm() {
     app_worker_send_message(WORKER_CMD_EXEC_ALARM, &msg_data);
 }
 
+/*
+ * Decisions within the wake window are traced when they change, not
+ * every minute
+ */
+static uint8_t last_alarm_decision = 0xFF;
+
+static void trace_alarm_decision(uint8_t decision) {
+    if (decision == last_alarm_decision)
+        return;
+    last_alarm_decision = decision;
+    trace(TRACE_ALARM_CHECK, decision << 8 | current_sleep_phase);
+}
+
 void check_alarm() {
     if (alarm_in_motion)
         return;
@@ -197,6 +271,7 @@ void check_alarm() {
             }
 
             if (inTime && current_sleep_phase == LIGHT) {
+                trace_alarm_decision(TRACE_ALARM_LIGHT);
                 main_app_exec_alarm();
                 return;
             }
@@ -212,9 +287,11 @@ void check_alarm() {
             }
 
             if (delta_time_h < h || (delta_time_h == h && delta_time_m < m)) {
+                trace_alarm_decision(TRACE_ALARM_DEADLINE);
                 main_app_exec_alarm();
                 return;
             }
+            trace_alarm_decision(TRACE_ALARM_WAIT);
         }
     }
 }
@@ -229,12 +306,15 @@ static void calc_and_store_motion_value() {
     ? prev_value + (med_val*((float)config.up_coef/10))
     : prev_value - (med_val*((float)config.down_coef/10));
 
+    SleepPhases previous_phase = current_sleep_phase;
     for (int i = 1; i < COUNT_TRESHOLDS; i++) {
         if (median_peek > thresholds[i-1] && median_peek <= thresholds[i]) {
             current_sleep_phase = i;
             break;
         }
     }
+    if (current_sleep_phase != previous_phase)
+        trace(TRACE_PHASE, current_sleep_phase);
     sleep_data.stat[current_sleep_phase-1] += 1;
 
     sleep_data.count_values += 1;
@@ -271,6 +351,12 @@ static void memo_motion(uint16_t peek) {
 static void motion_timer_callback(void *data) {
     AccelData accel = (AccelData) { .x = 0, .y = 0, .z = 0 };
     int res = accel_service_peek(&accel);
+    counters.motion_runs++;
+    if (res == -1 || res == -2) {
+        counters.peek_failures++;
+    } else if (accel.did_vibrate) {
+        counters.vibrate_skips++;
+    }
     if (res == -1 || res == -2 || accel.did_vibrate) {
     	// When accel is not running or already subscribed
     	// Not interested in values from vibration
@@ -316,7 +402,7 @@ static void motion_timer_callback(void *data) {
 }
 
 void persist_read_config() {
-    persist_read_data(CONFIG_PERSISTENT_KEY, &config, sizeof(config));
+    read_data(CONFIG_PERSISTENT_KEY, &config, sizeof(config));
     if (config.up_coef != UP_COEF_NOTSENSITIVE &&
         config.up_coef != UP_COEF_NORMAL &&
         config.up_coef != UP_COEF_VERYSENSITIVE) {
@@ -328,29 +414,77 @@ void persist_read_config() {
         config.down_coef = DOWN_COEF_NORMAL;
     }
 }
+static void send_live_value(uint16_t type) {
+    uint8_t value = sleep_data.minutes_value[sleep_data.count_values]*MEASURE_COEFICENT;
+    AppWorkerMessage msg_data = {
+        .data0 = sleep_data.count_values,
+        .data1 = value,
+        .data2 = current_sleep_phase
+    };
+    app_worker_send_message(type, &msg_data);
+}
+
+static void send_minute_value() {
+    if (!app_open || sleep_data.count_values == last_sent_count)
+        return;
+    last_sent_count = sleep_data.count_values;
+    send_live_value(WORKER_CMD_MINUTE_VALUE);
+}
+
 // Every minute
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+    counters.minute_ticks++;
     persist_read_config(); // It might be changed from UI
+
+    uint32_t started = timestamp_ms();
     calc_and_store_motion_value();
+    uint32_t took = timestamp_ms() - started;
+    counters.calc_ms_total += took;
+    if (took > counters.calc_ms_max)
+        counters.calc_ms_max = took;
+
+    send_minute_value();
+
+    started = timestamp_ms();
     check_alarm();
+    took = timestamp_ms() - started;
+    counters.alarm_ms_total += took;
+    if (took > counters.alarm_ms_max)
+        counters.alarm_ms_max = took;
 }
 
 static void pebslee_app_message_handler(uint16_t type, AppWorkerMessage *data) {
     if (type == APP_CMD_STOP_CAPTURING) {
         stop_sleep_data_capturing();
         store_data(&sleep_data);
+        trace_persist();
+        write_account_persist();
+    } else if (type == APP_CMD_APP_OPEN) {
+        app_open = YES;
+        // The live view shows the night right away, not at the next minute
+        send_live_value(WORKER_CMD_LIVE_SNAPSHOT);
+    } else if (type == APP_CMD_APP_CLOSED) {
+        app_open = NO;
     }
 }
 
 static void init() {
     // APP_LOG(APP_LOG_LEVEL_DEBUG, "Init worker");
     // Initialize your worker here
+    trace(TRACE_BOOT, 1);
+    write_account_init();
     persist_read_config();
-    //app_worker_message_subscribe(pebslee_app_message_handler);
+    app_worker_message_subscribe(pebslee_app_message_handler);
     motion_peek_in_min = 0;
     start_sleep_data_capturing();
     timer = app_timer_register(ACCEL_STEP_MS, motion_timer_callback, NULL);
     tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
+
+    // Ask an open app to identify itself
+    AppWorkerMessage msg_data = {
+        .data0 = 0
+    };
+    app_worker_send_message(WORKER_CMD_STARTED, &msg_data);
 }
 
 static void deinit() {
@@ -358,14 +492,19 @@ static void deinit() {
     // Deinitialize your worker here
     stop_sleep_data_capturing();
     store_data(&sleep_data);
+    // One write each - store_data() leaves them to the callers
+    trace(TRACE_EXIT, 1);
+    trace_persist();
+    write_account_persist();
 
     app_timer_cancel(timer);
     tick_timer_service_unsubscribe();
-    //app_worker_message_unsubscribe();
+    app_worker_message_unsubscribe();
 }
 
 int main(void) {
     init();
     worker_event_loop();
     deinit();
+    return 0;
 }